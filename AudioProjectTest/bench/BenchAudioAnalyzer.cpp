@@ -0,0 +1,980 @@
+#include "AllocationCounter.h"
+#include "AudioAnalyzer.h"
+#include "MultiAnalyzer.h"
+#include "PerfCounters.h"
+#include "Samples.h"
+#include "Simd.h"
+#include "WindowRegistry.h"
+#include "Windowing.h"
+
+#include "fftw3.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Times each stage of the chunk pipeline in isolation, on synthetic signals,
+// plus the whole thing end to end. Prints one CSV row per measurement:
+//
+//   stage,simd,fft_size,window,overlap,planner,ns_per_frame,frames_per_s,mb_per_s,allocs_per_frame
+//
+// For the stage rows, a "frame" is one chunk and MB/s counts the int16 audio
+// it covers (fftSize * 2 bytes). The convert_<format> rows are the same
+// Hann-windowed convert from the other sample formats (see Samples), with
+// MB/s counting that format's bytes. For the pipeline rows, MB/s is input
+// file bytes per second, so overlap shows up there. allocs_per_frame is only
+// filled in for builds with COUNT_ALLOCATIONS
+//
+// With --perf, each row also gets <event>_per_frame and <event>_per_sample
+// columns for the hardware counters (see PerfCounters.h), empty for any the
+// CPU or kernel won't give us. A "sample" is one sample of the bytes above
+//
+// Flags:
+//   --sizes=256,1024,...   FFT sizes (default 256 through 8192)
+//   --simd=avx2,...        Kernel sets (default every one the CPU supports)
+//   --min-time=0.2         Seconds to spend on each measurement
+//   --no-pipeline          Skip the end-to-end rows
+//   --perf                 Add hardware counter columns
+//   --check-kernels        Only check the kernels (see below), no timing
+//   --check-allocations    Only check allocations (see below), no timing
+//
+// Before timing a size, every kernel set's post-FFT kernels are checked
+// against the scalar ones on a real spectrum, the energies the converts
+// return against a double-precision sum, and every sample format's decoded
+// output against the scalar decode. A mismatch is an error (exit 1).
+// --check-kernels does just that, for every size (run by ctest)
+//
+// --check-allocations runs each way of analyzing a file (mapped, streamed,
+// threaded, split, decoded, swept, live) over a short file and one twice as
+// long, and fails (exit 1) unless both took the same number of allocations:
+// nothing in the steady state may allocate, per chunk or per block. It
+// needs a COUNT_ALLOCATIONS build, which the check_allocations target is
+// (run by ctest). Prints case,simd,short_file_allocs,long_file_allocs
+
+constexpr auto PI = 3.14159265358979323846f;
+constexpr auto SAMPLING_RATE = 8000.0f;
+
+// Anything read through this can't be optimized away
+static volatile float sink_ = 0.0f;
+
+// Whether rows get the hardware counter columns (--perf)
+static bool perf_ = false;
+
+struct Options_
+{
+    std::vector<std::size_t> fftSizes{ 256, 512, 1024, 2048, 4096, 8192 };
+    std::vector<Simd::Level> simdLevels{};
+    double minTimeSeconds = 0.2;
+    bool pipeline = true;
+    bool perf = false;
+    bool checkKernels = false;
+    bool checkAllocations = false;
+};
+
+struct Result_
+{
+    double nsPerFrame = 0.0;
+    double allocsPerFrame = 0.0;
+    PerfCounters::Values perfPerFrame{};
+};
+
+static Options_ parseOptions_(int argc, char* argv[]);
+static std::vector<std::string> split_(const std::string& string);
+
+static std::vector<std::int16_t> synthesize_(std::size_t count);
+static std::vector<unsigned char> encode_(const std::vector<std::int16_t>& samples, Samples::Format format);
+
+static Result_ time_(double minTimeSeconds, const std::function<void()>& frame);
+
+static void printHeader_();
+static void printRow_
+(
+    const char* stage,
+    const std::string& simd,
+    std::size_t fftSize,
+    const std::string& window,
+    float overlap,
+    const char* planner,
+    const Result_& result,
+    double bytesPerFrame,
+    std::size_t bytesPerSample = sizeof(std::int16_t)
+);
+
+static void checkKernels_(const Options_& options, std::size_t fftSize);
+static void benchKernels_(const Options_& options, std::size_t fftSize);
+static void benchFftw_(const Options_& options, std::size_t fftSize);
+static void benchPipeline_(const Options_& options, std::size_t fftSize);
+static bool checkAllocations_(const Options_& options);
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        auto options = parseOptions_(argc, argv);
+        perf_ = options.perf;
+
+        if (options.checkKernels)
+        {
+            for (auto fft_size : options.fftSizes)
+                checkKernels_(options, fft_size);
+
+            return 0;
+        }
+
+        if (options.checkAllocations)
+            return checkAllocations_(options) ? 0 : 1;
+
+        if (perf_ && !PerfCounters::available())
+            std::cerr << "Hardware counters unavailable (" << PerfCounters::unavailableReason() << ")" << std::endl;
+
+        printHeader_();
+
+        for (auto fft_size : options.fftSizes)
+        {
+            checkKernels_(options, fft_size);
+            benchKernels_(options, fft_size);
+            benchFftw_(options, fft_size);
+
+            if (options.pipeline)
+                benchPipeline_(options, fft_size);
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+}
+
+Options_ parseOptions_(int argc, char* argv[])
+{
+    Options_ options{};
+    std::map<std::string, std::string> flags{};
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) continue;
+
+        auto equal_pos = arg.find('=');
+
+        if (equal_pos != std::string::npos)
+            flags[arg.substr(2, equal_pos - 2)] = arg.substr(equal_pos + 1);
+        else
+            flags[arg.substr(2)] = "true";
+    }
+
+    if (auto it = flags.find("sizes"); it != flags.end())
+    {
+        options.fftSizes.clear();
+
+        for (auto& size : split_(it->second))
+            options.fftSizes.push_back(std::stoull(size));
+    }
+
+    if (auto it = flags.find("simd"); it != flags.end())
+    {
+        for (auto& name : split_(it->second))
+            options.simdLevels.push_back(Simd::fromString(name));
+    }
+    else
+    {
+        for (auto level : { Simd::Scalar, Simd::Sse41, Simd::Avx2, Simd::Avx512 })
+            if (Simd::supported(level)) options.simdLevels.push_back(level);
+    }
+
+    if (auto it = flags.find("min-time"); it != flags.end())
+        options.minTimeSeconds = std::stod(it->second);
+
+    options.pipeline = flags.find("no-pipeline") == flags.end();
+    options.perf = flags.find("perf") != flags.end();
+    options.checkKernels = flags.find("check-kernels") != flags.end();
+    options.checkAllocations = flags.find("check-allocations") != flags.end();
+
+    return options;
+}
+
+std::vector<std::string> split_(const std::string& string)
+{
+    std::vector<std::string> parts{};
+    std::istringstream iss(string);
+    std::string part{};
+
+    while (std::getline(iss, part, ','))
+        if (!part.empty()) parts.push_back(part);
+
+    return parts;
+}
+
+// Speech-ish tones plus noise, loud enough to use most of the int16 range
+std::vector<std::int16_t> synthesize_(std::size_t count)
+{
+    std::vector<std::int16_t> samples(count);
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> noise(0.0f, 2000.0f);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto t = static_cast<float>(i) / SAMPLING_RATE;
+        auto value = 8000.0f * std::sin(2.0f * PI * 220.0f * t)
+            + 4000.0f * std::sin(2.0f * PI * 1375.0f * t)
+            + noise(rng);
+
+        samples[i] = static_cast<std::int16_t>(std::clamp(value, -32768.0f, 32767.0f));
+    }
+
+    return samples;
+}
+
+// Roughly the same signal in another format. The table formats just get
+// each sample's high byte, which is as good as anything for timing and for
+// checking the kernels agree
+std::vector<unsigned char> encode_(const std::vector<std::int16_t>& samples, Samples::Format format)
+{
+    auto bytes_per_sample = Samples::bytesPerSample(format);
+    std::vector<unsigned char> bytes(samples.size() * bytes_per_sample);
+
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        auto out = bytes.data() + (i * bytes_per_sample);
+        auto bits = static_cast<std::uint16_t>(samples[i]);
+
+        switch (format)
+        {
+        case Samples::Int16BigEndian:
+            out[0] = static_cast<unsigned char>(bits >> 8);
+            out[1] = static_cast<unsigned char>(bits & 0xFF);
+            break;
+
+        case Samples::Int24:
+            // (With something in the low byte, so it isn't just Int16)
+            out[0] = static_cast<unsigned char>(i * 37);
+            out[1] = static_cast<unsigned char>(bits & 0xFF);
+            out[2] = static_cast<unsigned char>(bits >> 8);
+            break;
+
+        case Samples::Float32:
+        {
+            auto value = samples[i] / 32768.0f;
+            std::memcpy(out, &value, sizeof(value));
+            break;
+        }
+
+        case Samples::Int8:
+        case Samples::MuLaw:
+        case Samples::ALaw:
+            out[0] = static_cast<unsigned char>(bits >> 8);
+            break;
+
+        default:
+        case Samples::Int16:
+            std::memcpy(out, &samples[i], sizeof(samples[i]));
+            break;
+        }
+    }
+
+    return bytes;
+}
+
+// Runs frame until minTimeSeconds have passed (after a warm-up), in rounds
+// that double in size so the clock isn't read every frame
+Result_ time_(double minTimeSeconds, const std::function<void()>& frame)
+{
+    using Clock = std::chrono::steady_clock;
+
+    for (auto i = 0; i < 16; ++i)
+        frame();
+
+    std::size_t frames = 0;
+    std::size_t round = 1;
+    double elapsed_ns = 0.0;
+    auto allocations = AllocationCounter::thisThread();
+    auto perf = perf_ ? PerfCounters::read() : PerfCounters::Values{};
+
+    while (elapsed_ns < minTimeSeconds * 1e9)
+    {
+        auto start = Clock::now();
+
+        for (std::size_t i = 0; i < round; ++i)
+            frame();
+
+        elapsed_ns += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        frames += round;
+        round *= 2;
+    }
+
+    Result_ result{};
+    result.nsPerFrame = elapsed_ns / frames;
+    result.allocsPerFrame = static_cast<double>(AllocationCounter::thisThread() - allocations) / frames;
+
+    if (perf_)
+    {
+        result.perfPerFrame = PerfCounters::read();
+        result.perfPerFrame -= perf;
+
+        for (auto& count : result.perfPerFrame.counts)
+            count /= frames;
+    }
+
+    return result;
+}
+
+void printHeader_()
+{
+    std::cout << "stage,simd,fft_size,window,overlap,planner,ns_per_frame,frames_per_s,mb_per_s,allocs_per_frame";
+
+    if (perf_)
+    {
+        for (auto i = 0; i < PerfCounters::EVENTS_COUNT; ++i)
+        {
+            auto name = PerfCounters::toString(static_cast<PerfCounters::Event>(i));
+            std::cout << "," << name << "_per_frame," << name << "_per_sample";
+        }
+    }
+
+    std::cout << std::endl;
+}
+
+void printRow_
+(
+    const char* stage,
+    const std::string& simd,
+    std::size_t fftSize,
+    const std::string& window,
+    float overlap,
+    const char* planner,
+    const Result_& result,
+    double bytesPerFrame,
+    std::size_t bytesPerSample
+)
+{
+    auto frames_per_s = 1e9 / result.nsPerFrame;
+
+    std::cout << stage << ","
+        << simd << ","
+        << fftSize << ","
+        << window << ","
+        << overlap << ","
+        << planner << ","
+        << result.nsPerFrame << ","
+        << frames_per_s << ","
+        << (frames_per_s * bytesPerFrame / 1e6) << ",";
+
+    if (AllocationCounter::enabled())
+        std::cout << result.allocsPerFrame;
+
+    if (perf_)
+    {
+        auto samples_per_frame = bytesPerFrame / bytesPerSample;
+
+        for (auto i = 0; i < PerfCounters::EVENTS_COUNT; ++i)
+        {
+            auto event = static_cast<PerfCounters::Event>(i);
+            std::cout << ",";
+
+            if (!PerfCounters::available(event)) std::cout << ",";
+            else std::cout << result.perfPerFrame.counts[i] << "," << (result.perfPerFrame.counts[i] / samples_per_frame);
+        }
+    }
+
+    std::cout << std::endl;
+}
+
+//---------- Stages ----------
+
+// Magnitudes have to be within a rounding (FMA) of scalar's; the static
+// verdicts have to match exactly. Energies only have to be close, since each
+// ISA sums in its own order (the energy gate has a 2x margin for that)
+void checkKernels_(const Options_& options, std::size_t fftSize)
+{
+    auto bins_count = (fftSize / 2) + 1;
+
+    auto samples = synthesize_(fftSize);
+    auto sample_bytes = reinterpret_cast<const unsigned char*>(samples.data());
+    auto input = fftwf_alloc_real(fftSize);
+    auto real = fftwf_alloc_real(bins_count);
+    auto imag = fftwf_alloc_real(bins_count);
+    std::vector<float> expected(bins_count), actual(bins_count), converted(fftSize), decoded(fftSize);
+
+    std::vector<std::vector<unsigned char>> encoded{};
+    for (std::size_t f = 0; f < Samples::FORMATS_COUNT; ++f)
+        encoded.push_back(encode_(samples, static_cast<Samples::Format>(f)));
+
+    fftwf_iodim transform{ static_cast<int>(fftSize), 1, 1 };
+    auto plan = fftwf_plan_guru_split_dft_r2c(1, &transform, 0, nullptr, input, real, imag, FFTW_ESTIMATE);
+    if (!plan) throw std::runtime_error("Failed to create FFTW plan.");
+
+    auto window = WindowRegistry::get(Windowing::Hann, fftSize);
+    Simd::scalarKernels().converts[Samples::Int16].convertWindowed(sample_bytes, window->data(), fftSize, input);
+    fftwf_execute(plan);
+
+    auto exact_energy = 0.0;
+    auto exact_windowed_energy = 0.0;
+
+    for (std::size_t i = 0; i < fftSize; ++i)
+    {
+        auto sample = static_cast<double>(samples[i]);
+        auto windowed = static_cast<double>(samples[i] * window->data()[i]);
+        exact_energy += sample * sample;
+        exact_windowed_energy += windowed * windowed;
+    }
+    fftwf_destroy_plan(plan);
+
+    auto& scalar = Simd::scalarKernels();
+    scalar.magnitudes(real, imag, bins_count, expected.data());
+
+    // Every bin (just) passing, then each of a few bins sitting exactly on the
+    // threshold, which has to fail
+    std::vector<float> thresholds_sq{ 0.0f };
+    auto quietest = *std::min_element(expected.begin(), expected.end());
+    thresholds_sq.push_back(0.99f * quietest * quietest);
+
+    for (std::size_t k = 0; k < bins_count; k += std::max(std::size_t(1), bins_count / 7))
+        thresholds_sq.push_back((real[k] * real[k]) + (imag[k] * imag[k]));
+
+    auto fail = [&](const char* what, Simd::Level level)
+    {
+        std::ostringstream oss;
+        oss << what << " (" << Simd::toString(level) << ", FFT size " << fftSize << ") disagrees with scalar";
+        throw std::runtime_error(oss.str());
+    };
+
+    for (auto level : options.simdLevels)
+    {
+        auto& kernels = Simd::kernels(level);
+        auto frame = Simd::frameKernels(kernels, fftSize);
+
+        auto check_energy = [&](float energy, double exact, const char* what)
+        {
+            if (std::fabs(energy - exact) > 1e-4 * exact) fail(what, level);
+        };
+
+        auto& int16 = kernels.converts[Samples::Int16];
+        check_energy(int16.convert(sample_bytes, fftSize, converted.data()), exact_energy, "convert energy");
+        check_energy(int16.convertWindowed(sample_bytes, window->data(), fftSize, converted.data()), exact_windowed_energy, "convertWindowed energy");
+
+        if (frame)
+        {
+            auto& frame_int16 = frame->converts[Samples::Int16];
+            check_energy(frame_int16.convert(sample_bytes, converted.data()), exact_energy, "fixed-size convert energy");
+            check_energy(frame_int16.convertWindowed(sample_bytes, window->data(), converted.data()), exact_windowed_energy, "fixed-size convertWindowed energy");
+        }
+
+        // Every format's decoded samples have to match scalar's exactly
+        // (decoding is exact, and windowing is one multiply either way),
+        // with and without a tail
+        for (std::size_t f = 0; f < Samples::FORMATS_COUNT; ++f)
+        {
+            auto bytes = encoded[f].data();
+            auto& expected_converts = scalar.converts[f];
+            auto& actual_converts = kernels.converts[f];
+
+            auto check_decoded = [&](std::size_t count, const char* what)
+            {
+                if (!std::equal(decoded.begin(), decoded.begin() + count, converted.begin()))
+                    fail((std::string(what) + " of " + Samples::toString(static_cast<Samples::Format>(f))).c_str(), level);
+            };
+
+            for (auto count : { fftSize, fftSize - std::min(fftSize, std::size_t(5)) })
+            {
+                expected_converts.convert(bytes, count, decoded.data());
+                actual_converts.convert(bytes, count, converted.data());
+                check_decoded(count, "convert");
+
+                expected_converts.convertWindowed(bytes, window->data(), count, decoded.data());
+                actual_converts.convertWindowed(bytes, window->data(), count, converted.data());
+                check_decoded(count, "convertWindowed");
+            }
+
+            if (frame)
+            {
+                expected_converts.convertWindowed(bytes, window->data(), fftSize, decoded.data());
+                frame->converts[f].convertWindowed(bytes, window->data(), converted.data());
+                check_decoded(fftSize, "fixed-size convertWindowed");
+
+                expected_converts.convert(bytes, fftSize, decoded.data());
+                frame->converts[f].convert(bytes, converted.data());
+                check_decoded(fftSize, "fixed-size convert");
+            }
+        }
+
+        auto check_magnitudes = [&](const char* what)
+        {
+            for (std::size_t k = 0; k < bins_count; ++k)
+                if (std::fabs(actual[k] - expected[k]) > 1e-6f * std::max(expected[k], 1.0f))
+                    fail(what, level);
+        };
+
+        kernels.magnitudes(real, imag, bins_count, actual.data());
+        check_magnitudes("magnitudes");
+
+        if (frame)
+        {
+            frame->magnitudes(real, imag, actual.data());
+            check_magnitudes("fixed-size magnitudes");
+        }
+
+        for (auto threshold_sq : thresholds_sq)
+        {
+            auto verdict = scalar.allAbove(real, imag, bins_count, threshold_sq);
+
+            if (kernels.allAbove(real, imag, bins_count, threshold_sq) != verdict)
+                fail("allAbove", level);
+
+            if (frame && frame->allAbove(real, imag, threshold_sq) != verdict)
+                fail("fixed-size allAbove", level);
+        }
+    }
+
+    fftwf_free(imag);
+    fftwf_free(real);
+    fftwf_free(input);
+}
+
+void benchKernels_(const Options_& options, std::size_t fftSize)
+{
+    auto bins_count = (fftSize / 2) + 1;
+    auto frame_bytes = static_cast<double>(fftSize * sizeof(std::int16_t));
+
+    auto samples = synthesize_(fftSize);
+    auto sample_bytes = reinterpret_cast<const unsigned char*>(samples.data());
+    auto input = fftwf_alloc_real(fftSize);
+    auto real = fftwf_alloc_real(bins_count);
+    auto imag = fftwf_alloc_real(bins_count);
+    auto magnitudes = fftwf_alloc_real(bins_count);
+
+    std::vector<std::vector<unsigned char>> encoded{};
+    for (std::size_t f = 0; f < Samples::FORMATS_COUNT; ++f)
+        encoded.push_back(encode_(samples, static_cast<Samples::Format>(f)));
+
+    // Every bin above the static threshold, so detection scans all of them
+    // (the worst case; speech usually bails out within a few bins)
+    constexpr auto threshold = 1000.0f;
+    std::mt19937 rng(5678);
+    std::uniform_real_distribution<float> loud(threshold, 4.0f * threshold);
+
+    for (std::size_t k = 0; k < bins_count; ++k)
+    {
+        real[k] = loud(rng);
+        imag[k] = loud(rng);
+    }
+
+    for (auto level : options.simdLevels)
+    {
+        auto& kernels = Simd::kernels(level);
+        auto simd = Simd::toString(level);
+
+        for (auto window_type : { Windowing::None, Windowing::Triangular, Windowing::Hann, Windowing::Hamming, Windowing::Blackman, Windowing::FlatTop, Windowing::Gaussian })
+        {
+            auto window = WindowRegistry::get(window_type, fftSize);
+            auto window_name = Windowing::toString(window_type);
+
+            auto result = time_
+            (
+                options.minTimeSeconds,
+                [&]
+                {
+                    if (!window)
+                        kernels.converts[Samples::Int16].convert(sample_bytes, fftSize, input);
+                    else
+                        kernels.converts[Samples::Int16].convertWindowed(sample_bytes, window->data(), fftSize, input);
+
+                    sink_ = input[fftSize / 2];
+                }
+            );
+
+            printRow_("convert", simd, fftSize, window_name, 0.0f, "", result, frame_bytes);
+        }
+
+        // The other sample formats' decoders, with the usual window
+        auto hann = WindowRegistry::get(Windowing::Hann, fftSize);
+
+        for (std::size_t f = 0; f < Samples::FORMATS_COUNT; ++f)
+        {
+            auto format = static_cast<Samples::Format>(f);
+            if (format == Samples::Int16) continue;
+
+            auto bytes = encoded[f].data();
+            auto bytes_per_sample = Samples::bytesPerSample(format);
+
+            auto result = time_
+            (
+                options.minTimeSeconds,
+                [&]
+                {
+                    kernels.converts[f].convertWindowed(bytes, hann->data(), fftSize, input);
+                    sink_ = input[fftSize / 2];
+                }
+            );
+
+            auto stage = "convert_" + Samples::toString(format);
+
+            printRow_
+            (
+                stage.c_str(),
+                simd,
+                fftSize,
+                Windowing::toString(Windowing::Hann),
+                0.0f,
+                "",
+                result,
+                static_cast<double>(fftSize * bytes_per_sample),
+                bytes_per_sample
+            );
+        }
+
+        // A remainder chunk half the FFT size
+        auto result = time_
+        (
+            options.minTimeSeconds,
+            [&]
+            {
+                kernels.zero(input + (fftSize / 2), fftSize - (fftSize / 2));
+                sink_ = input[fftSize - 1];
+            }
+        );
+
+        printRow_("zero_pad", simd, fftSize, "", 0.0f, "", result, frame_bytes);
+
+        result = time_
+        (
+            options.minTimeSeconds,
+            [&]
+            {
+                kernels.magnitudes(real, imag, bins_count, magnitudes);
+                sink_ = magnitudes[bins_count / 2];
+            }
+        );
+
+        printRow_("magnitude", simd, fftSize, "", 0.0f, "", result, frame_bytes);
+
+        result = time_
+        (
+            options.minTimeSeconds,
+            [&]
+            {
+                sink_ = kernels.allAbove(real, imag, bins_count, threshold * threshold) ? 1.0f : 0.0f;
+            }
+        );
+
+        printRow_("detect", simd, fftSize, "", 0.0f, "", result, frame_bytes);
+
+        // The same again with the fixed-size frame kernels, where this size
+        // has them
+        auto frame = Simd::frameKernels(kernels, fftSize);
+        if (!frame) continue;
+
+        for (auto window_type : { Windowing::None, Windowing::Hann })
+        {
+            auto window = WindowRegistry::get(window_type, fftSize);
+
+            result = time_
+            (
+                options.minTimeSeconds,
+                [&]
+                {
+                    if (!window)
+                        frame->converts[Samples::Int16].convert(sample_bytes, input);
+                    else
+                        frame->converts[Samples::Int16].convertWindowed(sample_bytes, window->data(), input);
+
+                    sink_ = input[fftSize / 2];
+                }
+            );
+
+            printRow_("convert_fixed", simd, fftSize, Windowing::toString(window_type), 0.0f, "", result, frame_bytes);
+        }
+
+        result = time_
+        (
+            options.minTimeSeconds,
+            [&]
+            {
+                frame->magnitudes(real, imag, magnitudes);
+                sink_ = magnitudes[bins_count / 2];
+            }
+        );
+
+        printRow_("magnitude_fixed", simd, fftSize, "", 0.0f, "", result, frame_bytes);
+
+        result = time_
+        (
+            options.minTimeSeconds,
+            [&]
+            {
+                sink_ = frame->allAbove(real, imag, threshold * threshold) ? 1.0f : 0.0f;
+            }
+        );
+
+        printRow_("detect_fixed", simd, fftSize, "", 0.0f, "", result, frame_bytes);
+    }
+
+    fftwf_free(magnitudes);
+    fftwf_free(imag);
+    fftwf_free(real);
+    fftwf_free(input);
+}
+
+// FFTW picks its own SIMD, so these rows aren't per kernel set
+void benchFftw_(const Options_& options, std::size_t fftSize)
+{
+    auto bins_count = (fftSize / 2) + 1;
+    auto frame_bytes = static_cast<double>(fftSize * sizeof(std::int16_t));
+    auto samples = synthesize_(fftSize);
+
+    auto input = fftwf_alloc_real(fftSize);
+    auto real = fftwf_alloc_real(bins_count);
+    auto imag = fftwf_alloc_real(bins_count);
+
+    // Split output, like the analyzer's
+    fftwf_iodim transform{ static_cast<int>(fftSize), 1, 1 };
+
+    for (auto [planner_flags, planner] : { std::pair{ FFTW_ESTIMATE, "estimate" }, std::pair{ FFTW_MEASURE, "measure" } })
+    {
+        // (MEASURE scribbles over the buffers, so fill them after planning)
+        auto plan = fftwf_plan_guru_split_dft_r2c(1, &transform, 0, nullptr, input, real, imag, planner_flags);
+        if (!plan) throw std::runtime_error("Failed to create FFTW plan.");
+
+        for (std::size_t i = 0; i < fftSize; ++i)
+            input[i] = samples[i];
+
+        auto result = time_
+        (
+            options.minTimeSeconds,
+            [&]
+            {
+                fftwf_execute(plan);
+                sink_ = real[bins_count / 2];
+            }
+        );
+
+        printRow_("fft", "fftw", fftSize, "", 0.0f, planner, result, frame_bytes);
+        fftwf_destroy_plan(plan);
+    }
+
+    fftwf_free(imag);
+    fftwf_free(real);
+    fftwf_free(input);
+}
+
+// The whole analyzer on a synthetic file (a few seconds of audio), through
+// the default (memory-mapped, batched) path
+void benchPipeline_(const Options_& options, std::size_t fftSize)
+{
+    auto path = std::filesystem::temp_directory_path() / "bench_audioanalyzer.raw";
+    auto samples = synthesize_(static_cast<std::size_t>(SAMPLING_RATE) * 60);
+
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(std::int16_t));
+    }
+
+    auto file_bytes = static_cast<double>(samples.size() * sizeof(std::int16_t));
+
+    for (auto level : options.simdLevels)
+    {
+        for (auto window_type : { Windowing::None, Windowing::Hann })
+        {
+            for (auto overlap : { 0.0f, 0.5f, 0.75f })
+            {
+                AudioAnalyzer::Config config{};
+                config.fftSize = fftSize;
+                config.windowType = window_type;
+                config.overlap = overlap;
+                config.simd = level;
+
+                AudioAnalyzer analyzer(config);
+                std::size_t frames = 0;
+
+                // Timed per file, then scaled down to per frame
+                auto result = time_
+                (
+                    options.minTimeSeconds,
+                    [&]
+                    {
+                        auto analysis = analyzer.process(path);
+                        frames = analysis.chunksCount;
+                        sink_ = static_cast<float>(analysis.staticFrames.count());
+                    }
+                );
+
+                result.nsPerFrame /= frames;
+                result.allocsPerFrame /= frames;
+
+                for (auto& count : result.perfPerFrame.counts)
+                    count /= frames;
+
+                printRow_
+                (
+                    "pipeline",
+                    Simd::toString(level),
+                    fftSize,
+                    Windowing::toString(window_type),
+                    overlap,
+                    "estimate",
+                    result,
+                    file_bytes / frames
+                );
+            }
+        }
+    }
+
+    std::filesystem::remove(path);
+}
+
+// Keeps nothing, so it never allocates itself
+class DropSink_ final : public AudioAnalyzer::Sink
+{
+public:
+    void onFileDone(std::size_t, AudioAnalyzer::Analysis&&) override {}
+};
+
+bool checkAllocations_(const Options_& options)
+{
+    if (!AllocationCounter::enabled())
+        throw std::runtime_error("--check-allocations needs a COUNT_ALLOCATIONS build (the check_allocations target)");
+
+    // Long enough that split files get the most spans either way, so only
+    // the chunk and block counts differ between the two
+    auto directory = std::filesystem::temp_directory_path();
+    auto samples = synthesize_(static_cast<std::size_t>(SAMPLING_RATE) * 360);
+    std::vector<std::vector<std::filesystem::path>> files(2);
+
+    for (auto format : { Samples::Int16, Samples::MuLaw })
+    {
+        auto bytes = encode_(samples, format);
+
+        for (std::size_t i = 0; i < files.size(); ++i)
+        {
+            // files[0] gets the first half, files[1] all of it
+            auto path = directory / ("bench_audioanalyzer_" + std::to_string(i) + "." + Samples::toString(format));
+            std::ofstream out(path, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size() / (2 - i)));
+            files[i].push_back(path);
+        }
+    }
+
+    struct Case
+    {
+        const char* name;
+        std::vector<AudioAnalyzer::Config> configs; // More than one is a sweep
+        std::size_t file = 0; // In files[i]
+        std::size_t copies = 1;
+        bool live = false;
+    };
+
+    AudioAnalyzer::Config base{};
+    base.threads = 1;
+    base.prefetch = 0;
+
+    auto with = [&base](const std::function<void(AudioAnalyzer::Config&)>& change)
+        {
+            auto config = base;
+            change(config);
+            return config;
+        };
+
+    auto mulaw = [](AudioAnalyzer::Config& config) { config.sampleFormat = Samples::MuLaw; };
+    auto no_mmap = [](AudioAnalyzer::Config& config) { config.memoryMap = false; };
+
+    std::vector<Case> cases
+    {
+        { "mapped", { base } },
+        { "stream", { with(no_mmap) } },
+        { "stats", { with([](auto& config) { config.stats = true; }) } },
+        { "threads", { with([](auto& config) { config.threads = 2; }) }, 0, 3 },
+        { "split", { with([](auto& config) { config.threads = 2; config.splitFiles = true; }) } },
+        { "mulaw", { with(mulaw) }, 1 },
+        { "sweep", { base, with([](auto& config) { config.fftSize = 300; config.overlap = 0.75f; }) } },
+        { "sweep_mulaw", { with(mulaw), with([&](auto& config) { mulaw(config); config.fftSize = 2048; }) }, 1 },
+        {
+            "sweep_mulaw_stream",
+            { with([&](auto& config) { mulaw(config); no_mmap(config); }), with([&](auto& config) { mulaw(config); no_mmap(config); config.fftSize = 300; }) },
+            1
+        },
+        { "live", { base }, 0, 1, true }
+    };
+
+    auto passed = true;
+    DropSink_ sink{};
+    std::cout << "case,simd,short_file_allocs,long_file_allocs" << std::endl;
+
+    for (auto level : options.simdLevels)
+    {
+        for (auto& test : cases)
+        {
+            auto configs = test.configs;
+            for (auto& config : configs) config.simd = level;
+
+            // Built once, so only the files are counted
+            std::unique_ptr<AudioAnalyzer> analyzer{};
+            std::unique_ptr<MultiAnalyzer> multi{};
+
+            if (configs.size() > 1)
+                multi = std::make_unique<MultiAnalyzer>(configs);
+            else
+                analyzer = std::make_unique<AudioAnalyzer>(configs.front());
+
+            auto run = [&](std::size_t length)
+                {
+                    std::vector<std::filesystem::path> paths(test.copies, files[length][test.file]);
+
+                    if (multi)
+                    {
+                        multi->process(paths, sink);
+                    }
+                    else if (test.live)
+                    {
+                        std::ifstream raw_audio(paths.front(), std::ios::binary);
+                        analyzer->processStream(raw_audio, paths.front(), sink);
+                    }
+                    else
+                    {
+                        analyzer->process(paths, sink);
+                    }
+                };
+
+            // (The first run warms up whatever is sized on first use)
+            run(0);
+
+            std::size_t allocations[2]{};
+
+            for (std::size_t length = 0; length < 2; ++length)
+            {
+                auto start = AllocationCounter::total();
+                run(length);
+                allocations[length] = AllocationCounter::total() - start;
+            }
+
+            std::cout << test.name << "," << Simd::toString(level) << "," << allocations[0] << "," << allocations[1] << std::endl;
+
+            if (allocations[0] != allocations[1])
+            {
+                std::cerr << "Allocations grow with file length: " << test.name << " (" << Simd::toString(level) << ")" << std::endl;
+                passed = false;
+            }
+        }
+    }
+
+    for (auto& length : files)
+        for (auto& path : length)
+            std::filesystem::remove(path);
+
+    return passed;
+}
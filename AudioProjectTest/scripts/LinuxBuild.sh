@@ -22,7 +22,7 @@ FFTW_LIBRARY_DIR="/usr/local/lib"
 FORCE_FFTW=0
 
 # Boolean build options (default OFF)
-USE_AVX2=OFF
+COUNT_ALLOCATIONS=OFF
 
 # Process command-line arguments
 # We're checking for:
@@ -34,8 +34,8 @@ for arg in "$@"; do
         --forcelibbuild)
             FORCE_FFTW=1
             ;;
-        --avx2)
-            USE_AVX2=ON
+        --count-allocations)
+            COUNT_ALLOCATIONS=ON
             ;;
         --fftwlibpath=*)
             FFTW_LIBRARY_DIR="${arg#*=}"
@@ -50,7 +50,7 @@ done
 
 # Add boolean flags to CMake args
 CMAKE_ARGS+=(
-    "-DUSE_AVX2=$USE_AVX2"
+    "-DCOUNT_ALLOCATIONS=$COUNT_ALLOCATIONS"
     "-DFFTW_INCLUDE_DIR=$FFTW_INCLUDE_DIR"
     "-DFFTW_LIBRARY=$FFTW_LIBRARY_DIR/libfftw3f.a"
 )
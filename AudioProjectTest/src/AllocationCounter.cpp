@@ -0,0 +1,132 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(COUNT_ALLOCATIONS)
+
+namespace
+{
+    std::atomic<std::size_t> total_allocations{ 0 };
+    thread_local std::size_t thread_allocations = 0;
+
+    void count() noexcept
+    {
+        total_allocations.fetch_add(1, std::memory_order_relaxed);
+        ++thread_allocations;
+    }
+
+    void* allocate(std::size_t size)
+    {
+        count();
+
+        if (size == 0) size = 1;
+
+        while (true)
+        {
+            if (auto pointer = std::malloc(size)) return pointer;
+
+            auto handler = std::get_new_handler();
+            if (!handler) throw std::bad_alloc{};
+            handler();
+        }
+    }
+
+    void* allocateAligned(std::size_t size, std::align_val_t alignment)
+    {
+        count();
+
+        auto align = static_cast<std::size_t>(alignment);
+        if (align < sizeof(void*)) align = sizeof(void*);
+        if (size == 0) size = 1;
+
+        while (true)
+        {
+            void* pointer = nullptr;
+            if (::posix_memalign(&pointer, align, size) == 0) return pointer;
+
+            auto handler = std::get_new_handler();
+            if (!handler) throw std::bad_alloc{};
+            handler();
+        }
+    }
+
+} // namespace
+
+//---------- Replacements ----------
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try { return allocate(size); }
+    catch (...) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    try { return allocate(size); }
+    catch (...) { return nullptr; }
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+
+//---------- Counts ----------
+
+bool AllocationCounter::enabled() noexcept
+{
+    return true;
+}
+
+std::size_t AllocationCounter::total() noexcept
+{
+    return total_allocations.load(std::memory_order_relaxed);
+}
+
+std::size_t AllocationCounter::thisThread() noexcept
+{
+    return thread_allocations;
+}
+
+#else // !defined(COUNT_ALLOCATIONS)
+
+bool AllocationCounter::enabled() noexcept
+{
+    return false;
+}
+
+std::size_t AllocationCounter::total() noexcept
+{
+    return 0;
+}
+
+std::size_t AllocationCounter::thisThread() noexcept
+{
+    return 0;
+}
+
+#endif // defined(COUNT_ALLOCATIONS)
+
+void AllocationCounter::expectNone(std::size_t since, const char* where)
+{
+    auto allocations = thisThread() - since;
+    if (allocations == 0) return;
+
+    std::ostringstream oss{};
+    oss << allocations << " heap allocation(s) in " << where << ".";
+    throw std::logic_error(oss.str());
+}
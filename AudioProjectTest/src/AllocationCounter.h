@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts heap allocations, for checking that the per-chunk loop doesn't make
+// any. Counting only happens in builds configured with COUNT_ALLOCATIONS
+// (which replaces the global operator new); otherwise everything here reads
+// as zero and expectNone never throws.
+namespace AllocationCounter
+{
+    bool enabled() noexcept;
+
+    // Allocations made by every thread, and by the calling thread alone
+    std::size_t total() noexcept;
+    std::size_t thisThread() noexcept;
+
+    // Throws std::logic_error if the calling thread has allocated since
+    // thisThread() returned `since`
+    void expectNone(std::size_t since, const char* where);
+
+} // namespace AllocationCounter
@@ -1,5 +1,15 @@
+#include "AllocationCounter.h"
 #include "AudioAnalyzer.h"
+#include "MappedFile.h"
+#include "PerfCounters.h"
+#include "Prefetcher.h"
+#include "Samples.h"
+#include "Simd.h"
+#include "Stats.h"
+#include "WindowRegistry.h"
 #include "Windowing.h"
+#include "Wisdom.h"
+#include "WorkStealingPool.h"
 
 #include "fftw3.h"
 
@@ -12,43 +22,116 @@
 #include <iomanip>
 #include <ios>
 #include <iostream>
+#include <memory>
+#include <numeric>
 #include <ostream>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
 #include <vector>
 
-#if defined(USE_AVX2)
-
-// AVX2 can accelerate operations involving repetitive mathematical computations
-// on vectors.
-#pragma message("Using AVX2 SIMD.")
-
-#include <immintrin.h>
-
-#endif
-
 std::ostream& operator<<(std::ostream& os, const AudioAnalyzer::Analysis& a)
 {
     std::ostringstream oss{};
-    oss << "File: " << a.file.string() << "\n"
+    oss << "File: " << a.file.string() << "\n";
+
+    if (!a.error.empty())
+        oss << "Error: " << a.error << "\n";
+
+    oss
         << "FFT Size: " << a.fftSize << "\n"
         << "Windowing: " << Windowing::toString(a.windowType) << "\n"
         << "Overlap: " << (a.overlapDecPercent * 100.0f) << "%\n"
         << "Chunk length (seconds): " << std::fixed << std::setprecision(2) << a.chunkDurationSeconds << "\n"
-        << "Staticky chunk start times: [";
+        << "Staticky chunks: " << a.staticFrames.count() << " of " << a.chunksCount << "\n"
+        << "Static seconds: " << a.staticFrames.staticSeconds()
+        << " (longest " << a.staticFrames.longestIntervalSeconds() << ")\n"
+        << "Static intervals (seconds): [";
+
+    // Format the intervals as a comma-separated list of start-end pairs
+    auto intervals = a.staticFrames.intervals();
 
-    // Format staticChunkStartTimes as a comma-separated list
-    for (std::size_t i = 0; i < a.staticChunkStartTimes.size(); ++i)
+    for (std::size_t i = 0; i < intervals.size(); ++i)
     {
         if (i > 0) oss << ", ";
-        oss << std::fixed << std::setprecision(2) << a.staticChunkStartTimes[i];
+        oss << intervals[i].startSeconds << "-" << intervals[i].endSeconds;
     }
     oss << "]";
 
+    if (a.staticChunkStartTimes)
+    {
+        oss << "\nStaticky chunk start times: [";
+
+        // Format staticChunkStartTimes as a comma-separated list
+        for (std::size_t i = 0; i < a.staticChunkStartTimes->size(); ++i)
+        {
+            if (i > 0) oss << ", ";
+            oss << (*a.staticChunkStartTimes)[i];
+        }
+        oss << "]";
+    }
+
     return os << oss.str();
 }
 
+AudioAnalyzer::AudioAnalyzer(const Config& config)
+    : fftSize_(std::max(std::size_t(1), config.fftSize))
+    , threads_(config.threads ? config.threads : std::max(1u, std::thread::hardware_concurrency()))
+    , splitFiles_(config.splitFiles)
+    , memoryMap_(config.memoryMap)
+    , prefetch_(config.prefetch)
+    , stats_(config.stats)
+    , perfCounters_(config.stats && config.perfCounters)
+    , startTimes_(config.startTimes)
+    , spectrogramPath_(config.spectrogramPath)
+    , spectrogramFormat_(config.spectrogramFormat)
+    , spectrogramFirstBin_(config.spectrogramFirstBin)
+    , spectrogramEndBin_(config.spectrogramEndBin)
+    , sampleFormat_(config.sampleFormat)
+    , bytesPerSample_(Samples::bytesPerSample(config.sampleFormat))
+    , simd_(config.simd == Simd::Auto ? Simd::best() : config.simd)
+    , kernels_(&Simd::kernels(simd_))
+    , frameKernels_(Simd::frameKernels(*kernels_, fftSize_))
+    , converts_(&kernels_->converts[sampleFormat_])
+    , frameConverts_(frameKernels_ ? &frameKernels_->converts[sampleFormat_] : nullptr)
+    , windowType_(config.windowType)
+    , overlapDecPercent_(std::clamp(config.overlap, 0.0f, 0.9f))
+    , wisdomPath_(config.wisdomPath)
+    , planner_(config.planner)
+    , batchSize_(std::max(std::size_t(1), config.batchSize))
+{
+    // (A hop of 0 would never advance)
+    hopSize_ = std::max
+    (
+        std::size_t(1),
+        static_cast<std::size_t>(fftSize_ * (1.0f - overlapDecPercent_))
+    );
+
+    if (config.energyGate && fftSize_ <= MAX_GATED_FFT_SIZE_)
+        energyGate_ = 0.5f * STATIC_THRESHOLD_ * STATIC_THRESHOLD_;
+
+    if (!spectrogramPath_.empty())
+    {
+        auto bins_count = (fftSize_ / 2) + 1;
+        spectrogramEndBin_ = spectrogramEndBin_ ? std::min(spectrogramEndBin_, bins_count) : bins_count;
+
+        if (spectrogramFirstBin_ >= spectrogramEndBin_)
+            throw std::invalid_argument("Spectrogram bin range is empty.");
+
+        needMagnitudes_ = true;
+    }
+
+    auto plan_start = Stats::Clock::now();
+    initFftw_();
+    planSeconds_ = Stats::secondsSince(plan_start);
+
+    initWindow_();
+    initWorkers_();
+}
+
 AudioAnalyzer::AudioAnalyzer
 (
     std::size_t fftSize,
@@ -56,13 +139,8 @@ AudioAnalyzer::AudioAnalyzer
     float overlap,
     const std::filesystem::path& wisdomPath
 )
-    : fftSize_(std::max(std::size_t(1), fftSize))
-    , windowType_(windowType)
-    , overlapDecPercent_(std::clamp(overlap, 0.0f, 0.9f))
-    , wisdomPath_(wisdomPath)
+    : AudioAnalyzer(Config{ fftSize, windowType, overlap, wisdomPath })
 {
-    initFftw_();
-    initWindow_();
 }
 
 AudioAnalyzer::AudioAnalyzer(const std::filesystem::path& wisdomPath)
@@ -72,9 +150,63 @@ AudioAnalyzer::AudioAnalyzer(const std::filesystem::path& wisdomPath)
 
 AudioAnalyzer::~AudioAnalyzer()
 {
+    // Join the workers before their workspaces (and the plan) go away
+    pool_.reset();
     freeFftw_();
 }
 
+AudioAnalyzer::Workspace_::Workspace_
+(
+    std::size_t ringBytes,
+    std::size_t inputStride,
+    std::size_t outputStride,
+    std::size_t numFrequencyBins,
+    std::size_t batchSize
+)
+    : fftInputBuffer(fftwf_alloc_real(inputStride * batchSize))
+    , spectrum(fftwf_alloc_real(outputStride * batchSize))
+    , magnitudes(fftwf_alloc_real(numFrequencyBins))
+    , batchSize(batchSize)
+{
+    if (!fftInputBuffer || !spectrum || !magnitudes)
+    {
+        // Destructor won't run for a throwing constructor
+        fftwf_free(magnitudes);
+        fftwf_free(spectrum);
+        fftwf_free(fftInputBuffer);
+        throw std::runtime_error("Failed to allocate FFT buffers.");
+    }
+
+    // Everything the chunk loop touches is allocated up front, so analyzing
+    // doesn't allocate per chunk
+    ring.resize(ringBytes);
+    pending.reserve(batchSize);
+}
+
+AudioAnalyzer::Workspace_::~Workspace_()
+{
+    fftwf_free(magnitudes);
+    fftwf_free(spectrum);
+    fftwf_free(fftInputBuffer);
+}
+
+void AudioAnalyzer::process(const std::vector<std::filesystem::path>& inFiles, Sink& sink)
+{
+    sink_ = &sink;
+
+    try
+    {
+        process_(inFiles);
+    }
+    catch (...)
+    {
+        sink_ = nullptr;
+        throw;
+    }
+
+    sink_ = nullptr;
+}
+
 // Convenience overload for single process
 AudioAnalyzer::Analysis AudioAnalyzer::process(const std::filesystem::path& inFile)
 {
@@ -83,11 +215,65 @@ AudioAnalyzer::Analysis AudioAnalyzer::process(const std::filesystem::path& inFi
 
 std::vector<AudioAnalyzer::Analysis> AudioAnalyzer::process(const std::vector<std::filesystem::path>& inFiles)
 {
+    struct Collector : Sink
+    {
+        std::vector<Analysis>& analyses;
+
+        explicit Collector(std::vector<Analysis>& analyses) : analyses(analyses) {}
+
+        void onFileDone(std::size_t fileIndex, Analysis&& analysis) override
+        {
+            analyses[fileIndex] = std::move(analysis);
+        }
+    };
+
     std::vector<Analysis> analyses(inFiles.size());
-    process_(analyses, inFiles);
+    Collector collector(analyses);
+    process(inFiles, collector);
+
     return analyses;
 }
 
+void AudioAnalyzer::processStream
+(
+    std::istream& rawAudio,
+    const std::filesystem::path& name,
+    Sink& sink
+)
+{
+    // A batch of one, so nothing waits on chunks that haven't arrived yet.
+    // (Its own workspace, so this can't disturb anything queued by process)
+    Workspace_ workspace(fftSize_ * bytesPerSample_, inputStride_, outputStride_, numFrequencyBins_, 1);
+    auto analysis = makeAnalysis_(name);
+
+    sink_ = &sink;
+
+    try
+    {
+        // The stream reader never needs the size, so it doesn't care that
+        // the stream has no end yet. (No vector to collect times in, so
+        // they only go to the sink)
+        analysis.chunksCount = analyzeChunks_
+        (
+            rawAudio,
+            0,
+            NO_LAST_CHUNK_,
+            workspace,
+            Destination_{ 0, nullptr, &analysis.skippedChunksCount, stats_ ? &analysis.stats : nullptr }
+        );
+
+        flushChunks_(workspace);
+        emitFileDone_(0, std::move(analysis));
+    }
+    catch (...)
+    {
+        sink_ = nullptr;
+        throw;
+    }
+
+    sink_ = nullptr;
+}
+
 // Section off wisdom read/write
 void AudioAnalyzer::initFftw_()
 {
@@ -96,476 +282,1218 @@ void AudioAnalyzer::initFftw_()
     // fftwf_malloc
 
     numFrequencyBins_ = (fftSize_ / 2) + 1;
-    fftInputBuffer_ = fftwf_alloc_real(fftSize_);
-    fftOutputBuffer_ = fftwf_alloc_complex(numFrequencyBins_);
 
-    if (!fftInputBuffer_ || !fftOutputBuffer_)
-    {
-        throw std::runtime_error("Failed to allocate FFT buffers.");
-    }
+    constexpr std::size_t floats_per_64_bytes = 64 / sizeof(float);
+    inputStride_ = ((fftSize_ + floats_per_64_bytes - 1) / floats_per_64_bytes) * floats_per_64_bytes;
+    imagOffset_ = ((numFrequencyBins_ + floats_per_64_bytes - 1) / floats_per_64_bytes) * floats_per_64_bytes;
+    outputStride_ = 2 * imagOffset_;
+
+    workspaces_.emplace_back(std::make_unique<Workspace_>(fftSize_ * bytesPerSample_, inputStride_, outputStride_, numFrequencyBins_, batchSize_));
+
+    // Other workspaces' buffers come from the same allocator, so they share
+    // the planning buffers' alignment and the plans can run on any of them
+    auto input_buffer = workspaces_.front()->fftInputBuffer;
+    auto output_real = workspaces_.front()->spectrum;
+    auto output_imag = output_real + imagOffset_;
 
     auto fft_size = static_cast<int>(fftSize_);
+    auto planner_flags = Wisdom::flags(planner_, !wisdomPath_.empty());
+    std::string wisdom_before{};
 
     if (!wisdomPath_.empty())
     {
         // https://fftw.org/fftw3_doc/Words-of-Wisdom_002dSaving-Plans.html
-
-        // Try to load wisdom from file
         auto wisdom_path_str = wisdomPath_.string();
-        auto wisdom_found = static_cast<bool>(
-            fftwf_import_wisdom_from_filename(wisdom_path_str.c_str()));
+        auto load_start = Stats::Clock::now();
+        auto loaded = Wisdom::load(wisdomPath_);
+        wisdomLoadSeconds_ = Stats::secondsSince(load_start);
 
-        if (wisdom_found)
+        if (loaded)
         {
-            std::cout << "Wisdom file loaded from " << wisdom_path_str << std::endl;
+            std::cerr << "Wisdom file loaded from " << wisdom_path_str << std::endl;
         }
         else
         {
             std::cerr << "Failed to find wisdom file at " << wisdom_path_str << std::endl;
         }
 
-        fftwPlan_ = fftwf_plan_dft_r2c_1d
+        wisdom_before = Wisdom::snapshot();
+    }
+
+    // The guru interface is the one that can write split (real and
+    // imaginary) output. Contiguous in, contiguous out, in each plane
+    fftwf_iodim transform{ fft_size, 1, 1 };
+
+    fftwPlan_ = fftwf_plan_guru_split_dft_r2c
+    (
+        1,
+        &transform,
+        0,
+        nullptr,
+        input_buffer,
+        output_real,
+        output_imag,
+        planner_flags
+    );
+
+    if (batchSize_ > 1)
+    {
+        // One transform per slot, slots laid end to end
+        fftwf_iodim batch
+        {
+            static_cast<int>(batchSize_),
+            static_cast<int>(inputStride_),
+            static_cast<int>(outputStride_)
+        };
+
+        fftwBatchPlan_ = fftwf_plan_guru_split_dft_r2c
         (
-            fft_size,
-            fftInputBuffer_,
-            fftOutputBuffer_,
-            FFTW_MEASURE
+            1,
+            &transform,
+            1,
+            &batch,
+            input_buffer,
+            output_real,
+            output_imag,
+            planner_flags
         );
+    }
+
+    if (!fftwPlan_ || (batchSize_ > 1 && !fftwBatchPlan_))
+    {
+        throw std::runtime_error("Failed to create FFTW plans.");
+    }
 
-        if (!std::filesystem::exists(wisdomPath_.parent_path()))
+    // Save only if planning added something the file didn't have (a new
+    // size, batch, or effort)
+    if (!wisdomPath_.empty() && Wisdom::snapshot() != wisdom_before)
+    {
+        // Not worth failing the run over; the plans just won't be remembered
+        try
         {
-            std::filesystem::create_directories(wisdomPath_.parent_path());
+            Wisdom::save(wisdomPath_);
+            std::cerr << "Wisdom file saved to " << wisdomPath_.string() << std::endl;
         }
-
-        // Double check that this saves appropriately with variable FFT size,
-        // overlap, etc. It should save only when an optimzed plan for the
-        // current values wasn't found.
-        if (!wisdom_found)
+        catch (const std::exception& ex)
         {
-            if (fftwf_export_wisdom_to_filename(wisdom_path_str.c_str()))
-            {
-                std::cout << "Wisdom file saved to " << wisdom_path_str << std::endl;
-            }
-            else
-            {
-                std::cerr << "Failed to save wisdom to disk (" << wisdom_path_str << ")" << std::endl;
-            }
+            std::cerr << ex.what() << std::endl;
         }
     }
-    else // (wisdomPath_.empty())
-    {
-        fftwPlan_ = fftwf_plan_dft_r2c_1d
-        (
-            fft_size,
-            fftInputBuffer_,
-            fftOutputBuffer_,
-            FFTW_ESTIMATE
-        );
-    }
 }
 
 void AudioAnalyzer::freeFftw_()
 {
-    // If we only call this in destructor, then I guess we don't need checks or
-    // nullptr assignment
-    /*if (fftwPlan_)
-    {
-        fftwf_destroy_plan(fftwPlan_);
-        fftwPlan_ = nullptr;
-    }
+    // Workspaces free their own buffers
+    if (fftwBatchPlan_) fftwf_destroy_plan(fftwBatchPlan_);
+    if (fftwPlan_) fftwf_destroy_plan(fftwPlan_);
+}
 
-    if (fftOutputBuffer_)
-    {
-        fftwf_free(fftOutputBuffer_);
-        fftOutputBuffer_ = nullptr;
-    }
+void AudioAnalyzer::initWorkers_()
+{
+    if (threads_ < 2) return;
 
-    if (fftInputBuffer_)
-    {
-        fftwf_free(fftInputBuffer_);
-        fftInputBuffer_ = nullptr;
-    }*/
+    while (workspaces_.size() < threads_)
+        workspaces_.emplace_back(std::make_unique<Workspace_>(fftSize_ * bytesPerSample_, inputStride_, outputStride_, numFrequencyBins_, batchSize_));
 
-    fftwf_destroy_plan(fftwPlan_);
-    fftwf_free(fftOutputBuffer_);
-    fftwf_free(fftInputBuffer_);
+    pool_ = std::make_unique<WorkStealingPool>(threads_);
 }
 
 void AudioAnalyzer::initWindow_()
 {
     // Can perhaps get some benefit from testing different window types.
     // Ultimately, may only need one.
-    switch (windowType_)
-    {
-    case Windowing::Triangular:
-        window_ = Windowing::triangular(fftSize_);
-        break;
-    case Windowing::Hann:
-        window_ = Windowing::hann(fftSize_);
-        break;
-    case Windowing::Hamming:
-        window_ = Windowing::hamming(fftSize_);
-        break;
-    case Windowing::Blackman:
-        window_ = Windowing::blackman(fftSize_);
-        break;
-    case Windowing::FlatTop:
-        window_ = Windowing::flatTop(fftSize_);
-        break;
-    case Windowing::Gaussian:
-        window_ = Windowing::gaussian(fftSize_);
-        break;
-
-    default:
-    case Windowing::None:
-        useWindowing_ = false;
-        break;
-    }
-}
-
-// Parallelize FFT Computation?
-// Find common elements later
-// Refine into smaller functions (potentially called from both this and AVX2
-// function)
-void AudioAnalyzer::process_
-(
-    std::vector<Analysis>& analyses,
-    const std::vector<std::filesystem::path>& inFiles
-)
+    window_ = WindowRegistry::get(windowType_, fftSize_);
+    useWindowing_ = (window_ != nullptr);
+}
+
+void AudioAnalyzer::process_(const std::vector<std::filesystem::path>& inFiles)
 {
     if (inFiles.empty())
     {
         throw std::invalid_argument("No input files provided.");
     }
 
-    for (std::size_t i = 0; i < inFiles.size(); ++i)
+    try
     {
-        std::vector<float> static_chunk_start_times{}; // Eventual product
-        auto& in_file = inFiles[i];
-
-        // Should we throw or just continue (and add an error enum to result
-        // Analysis for this file, or something)
-        if (!std::filesystem::exists(in_file))
+        if (pool_ && splitFiles_)
         {
-            std::ostringstream oss{};
-            oss << "\"" << in_file.string() << "\" does not exist.";
-            throw std::runtime_error(oss.str());
+            processSpans_(inFiles);
+            return;
         }
 
-        if (!std::filesystem::is_regular_file(in_file))
+        if (!pool_ || inFiles.size() == 1)
         {
-            std::ostringstream oss{};
-            oss << "\"" << in_file.string() << "\" is not a regular file.";
-            throw std::runtime_error(oss.str());
+            auto& workspace = *workspaces_.front();
+
+            std::vector<std::size_t> order(inFiles.size());
+            std::iota(order.begin(), order.end(), std::size_t(0));
+            Prefetcher prefetcher(inFiles, std::move(order), prefetch_);
+
+            for (std::size_t i = 0; i < inFiles.size(); ++i)
+            {
+                prefetcher.reached(i);
+                auto analysis = std::make_unique<Analysis>();
+                std::unique_ptr<Spectrogram> spectrogram{};
+                processFile_(inFiles[i], i, workspace, *analysis, spectrogram);
+                finishFile_(workspace, i, std::move(analysis), std::move(spectrogram));
+            }
+
+            flushChunks_(workspace);
+            emitSettled_(workspace);
+            return;
         }
 
-        std::ifstream raw_audio(in_file, std::ios::binary);
+        processFiles_(inFiles);
+    }
+    catch (...)
+    {
+        // Queued chunks point into analyses that are about to go away
+        discardChunks_();
+        throw;
+    }
+}
 
-        if (!raw_audio)
+void AudioAnalyzer::beginFeed_(Feed_& feed, const std::filesystem::path& name, std::size_t totalSamples) const
+{
+    feed.analysis = makeAnalysis_(name);
+    feed.schedule = schedule_(totalSamples);
+    feed.analysis.staticFrames.reset(feed.schedule.framesCount());
+    feed.nextChunk = 0;
+}
+
+// samples holds the file's samples [firstSample, endSample), where
+// firstSample is at most the start of the feed's next chunk. Analyzes every
+// chunk that ends inside it, and returns the first sample a later block
+// still has to include (endSample, once there are no chunks left)
+std::size_t AudioAnalyzer::feed_
+(
+    Feed_& feed,
+    const unsigned char* samples,
+    std::size_t firstSample,
+    std::size_t endSample,
+    std::size_t fileIndex,
+    Sink& sink
+)
+{
+    auto& schedule = feed.schedule;
+    auto frames_count = schedule.framesCount();
+    auto last_chunk = frames_count;
+
+    // (Only the file's end can cut a chunk short)
+    if (endSample < schedule.totalSamples)
+    {
+        last_chunk = (endSample >= fftSize_)
+            ? std::min(frames_count, ((endSample - fftSize_) / schedule.hopSize) + 1)
+            : 0;
+    }
+
+    if (last_chunk > feed.nextChunk)
+    {
+        sink_ = &sink;
+
+        try
         {
-            std::ostringstream oss{};
-            oss << "Unable to open file at \"" << in_file.string() << "\"";
-            throw std::runtime_error(oss.str());
+            auto allocations = AllocationCounter::thisThread();
+
+            feed.analysis.chunksCount += analyzeChunks_
+            (
+                samples + (((feed.nextChunk * schedule.hopSize) - firstSample) * bytesPerSample_),
+                schedule,
+                feed.nextChunk,
+                last_chunk,
+                *workspaces_.front(),
+                Destination_
+                {
+                    fileIndex,
+                    &feed.analysis.staticFrames,
+                    &feed.analysis.skippedChunksCount,
+                    stats_ ? &feed.analysis.stats : nullptr
+                }
+            );
+
+            AllocationCounter::expectNone(allocations, "the chunk loop");
+        }
+        catch (...)
+        {
+            discardChunks_();
+            sink_ = nullptr;
+            throw;
         }
 
-        // Calculate raw audio stream size
-        auto raw_audio_size = sizeOf_(raw_audio);
+        sink_ = nullptr;
+        feed.nextChunk = last_chunk;
+    }
+
+    return (feed.nextChunk < frames_count) ? (feed.nextChunk * schedule.hopSize) : endSample;
+}
+
+// For a file that turned out shorter than it was when the feed began. Every
+// chunk analyzed so far is still whole, so only the rest are laid out again
+void AudioAnalyzer::truncateFeed_(Feed_& feed, std::size_t totalSamples) const
+{
+    feed.schedule = schedule_(totalSamples);
+    feed.nextChunk = std::min(feed.nextChunk, feed.schedule.framesCount());
+}
 
-        // Calculate number of chunks
-        // Before separating this off, we will need other variables in it
-        // (chunks_count, for example)...
-        auto hop_size = static_cast<std::size_t>(fftSize_ * (1.0f - overlapDecPercent_));
-        auto total_samples = raw_audio_size / sizeof(std::int16_t);
+void AudioAnalyzer::endFeed_(Feed_& feed, std::size_t fileIndex, Sink& sink)
+{
+    sink_ = &sink;
 
-        // Handle edge case where total_samples < fftSize_
-        auto chunks_count = (total_samples > fftSize_)
-            ? (((total_samples - fftSize_) / hop_size) + 1)
-            : 1;
+    try
+    {
+        flushChunks_(*workspaces_.front());
+        emitFileDone_(fileIndex, std::move(feed.analysis));
+    }
+    catch (...)
+    {
+        discardChunks_();
+        sink_ = nullptr;
+        throw;
+    }
+
+    sink_ = nullptr;
+}
 
-        if (chunks_count < 1)
+void AudioAnalyzer::processFiles_(const std::vector<std::filesystem::path>& inFiles)
+{
+    // Hand out the biggest files first. Stealing keeps everyone busy while a
+    // big file is running, but if one were submitted last it would still be
+    // the only thing left running at the end
+    std::vector<std::uintmax_t> sizes(inFiles.size(), 0);
+    for (std::size_t i = 0; i < inFiles.size(); ++i)
+    {
+        std::error_code ec{};
+        auto size = std::filesystem::file_size(inFiles[i], ec);
+        if (!ec) sizes[i] = size;
+    }
+
+    std::vector<std::size_t> order(inFiles.size());
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    std::stable_sort
+    (
+        order.begin(),
+        order.end(),
+        [&sizes](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; }
+    );
+
+    // Workers take files in roughly submission order (stealing from the back
+    // only once their own queue is empty), so prefetch in that order
+    Prefetcher prefetcher(inFiles, order, prefetch_);
+
+    for (std::size_t position = 0; position < order.size(); ++position)
+    {
+        pool_->submit
+        (
+            [this, &inFiles, &prefetcher, i = order[position], position](std::size_t workerIndex)
+            {
+                prefetcher.reached(position);
+                auto& workspace = *workspaces_[workerIndex];
+                auto analysis = std::make_unique<Analysis>();
+                std::unique_ptr<Spectrogram> spectrogram{};
+                processFile_(inFiles[i], i, workspace, *analysis, spectrogram);
+                finishFile_(workspace, i, std::move(analysis), std::move(spectrogram));
+            }
+        );
+    }
+
+    pool_->wait();
+
+    // Workers leave a partial batch behind (which may hold chunks from any of
+    // their files), so finish those off
+    for (auto& workspace : workspaces_)
+    {
+        flushChunks_(*workspace);
+        emitSettled_(*workspace);
+    }
+}
+
+// Like process_, but with files cut into spans of chunks, each its own task.
+// A single multi-hour recording then keeps every worker busy instead of one
+void AudioAnalyzer::processSpans_(const std::vector<std::filesystem::path>& inFiles)
+{
+    struct Span
+    {
+        std::size_t fileIndex = 0;
+        std::size_t firstChunk = 0;
+        std::size_t lastChunk = 0;
+        std::size_t skippedChunksCount = 0;
+        Stats::Counters stats{};
+        std::string error{}; // Fails the whole file
+    };
+
+    std::vector<Schedule_> schedules(inFiles.size());
+    std::vector<Span> spans{};
+
+    // Every span of a file sets its bits straight in the file's analysis
+    // (and writes its rows straight into the file's spectrogram)
+    std::vector<Analysis> analyses(inFiles.size());
+    std::vector<std::unique_ptr<Spectrogram>> spectrograms(inFiles.size());
+
+    // Each file's spans are contiguous in spans, starting here. Whoever
+    // finishes a file's last span puts its Analysis together
+    std::vector<std::size_t> first_spans(inFiles.size(), 0);
+    std::vector<std::size_t> spans_left(inFiles.size(), 0);
+    std::mutex spans_mutex{};
+
+    for (std::size_t i = 0; i < inFiles.size(); ++i)
+    {
+        first_spans[i] = spans.size();
+
+        // A file that can't be analyzed gets no spans, and is done already
+        std::error_code ec{};
+        auto error = checkFile_(inFiles[i]);
+        auto file_size = error.empty() ? std::filesystem::file_size(inFiles[i], ec) : 0;
+
+        if (!error.empty() || ec)
         {
-            throw std::runtime_error("Lol what");
+            auto analysis = makeAnalysis_(inFiles[i]);
+            analysis.error = error.empty() ? ec.message() : error;
+            emitFileDone_(i, std::move(analysis));
+            continue;
         }
 
-        std::vector<std::int16_t> buffer(fftSize_);
+        schedules[i] = schedule_(file_size / bytesPerSample_);
 
-        if (chunks_count == 1)
+        if (!spectrogramPath_.empty())
         {
-            raw_audio.read
-            (
-                reinterpret_cast<char*>(buffer.data()),
-                total_samples * sizeof(std::int16_t)
-            );
-
-            fftAnalyzeChunk_
-            (
-                buffer,
-                0.0f,
-                static_chunk_start_times,
-                IsLastChunk_::Yes
-            );
+            try
+            {
+                spectrograms[i] = openSpectrogram_(inFiles[i], schedules[i].framesCount());
+            }
+            catch (const std::exception& ex)
+            {
+                auto analysis = makeAnalysis_(inFiles[i]);
+                analysis.error = ex.what();
+                emitFileDone_(i, std::move(analysis));
+                continue;
+            }
         }
-        else // (chunks_count > 1)
+
+        // Aim for a few spans per thread, so stealing can even out the tail.
+        // (Rounded up to whole words of bits, so no two spans write the same
+        // one)
+        auto frames_count = schedules[i].framesCount();
+        auto target_spans = threads_ * 4;
+        auto span_chunks = std::max(MIN_SPAN_CHUNKS_, (frames_count + target_spans - 1) / target_spans);
+        span_chunks = ((span_chunks + Detections::FRAMES_PER_WORD - 1) / Detections::FRAMES_PER_WORD)
+            * Detections::FRAMES_PER_WORD;
+
+        analyses[i] = makeAnalysis_(inFiles[i]);
+        analyses[i].chunksCount = frames_count;
+        analyses[i].staticFrames.reset(frames_count);
+
+        for (std::size_t first = 0; first < frames_count; first += span_chunks)
+            spans.push_back({ i, first, std::min(frames_count, first + span_chunks) });
+
+        spans_left[i] = spans.size() - first_spans[i];
+    }
+
+    std::vector<std::size_t> order(spans.size());
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    std::stable_sort
+    (
+        order.begin(),
+        order.end(),
+        [&spans](std::size_t a, std::size_t b)
         {
-            // Determine if there's a remainder based on the hop_size
-            auto has_remainder = (total_samples > (chunks_count * hop_size));
+            return (spans[a].lastChunk - spans[a].firstChunk) > (spans[b].lastChunk - spans[b].firstChunk);
+        }
+    );
 
-            // Analyze full chunks and record start time (in seconds) of chunks with static
-            for (std::size_t chunk_i = 0; chunk_i < chunks_count; ++chunk_i)
+    auto analyze_span = [this, &schedules, &analyses, &spectrograms, &inFiles](Span& span, Workspace_& workspace)
+        {
+            auto& in_file = inFiles[span.fileIndex];
+            auto& schedule = schedules[span.fileIndex];
+            Destination_ destination
             {
-                raw_audio.read
+                span.fileIndex,
+                &analyses[span.fileIndex].staticFrames,
+                &span.skippedChunksCount,
+                stats_ ? &span.stats : nullptr,
+                spectrograms[span.fileIndex].get()
+            };
+
+            if (memoryMap_)
+            {
+                // Map just the samples this span covers
+                auto first_sample = span.firstChunk * schedule.hopSize;
+                auto end_sample = std::min
                 (
-                    reinterpret_cast<char*>(buffer.data()),
-                    fftSize_ * sizeof(std::int16_t)
+                    schedule.totalSamples,
+                    ((span.lastChunk - 1) * schedule.hopSize) + fftSize_
                 );
 
-                auto chunk_start_time = static_cast<float>(chunk_i * hop_size) / SAMPLING_RATE_;
+                auto map_start = stats_ ? Stats::Clock::now() : Stats::Clock::time_point{};
 
-                fftAnalyzeChunk_
+                MappedFile mapped
                 (
-                    buffer,
-                    chunk_start_time,
-                    static_chunk_start_times
+                    in_file,
+                    first_sample * bytesPerSample_,
+                    (end_sample - first_sample) * bytesPerSample_
                 );
 
-                // Seek back to account for overlap
-                // Sliding buffer instead?
-                raw_audio.seekg
-                (
-                    -static_cast<std::streamoff>(fftSize_ - hop_size) * sizeof(std::int16_t),
-                    std::ios::cur
-                );
+                if (stats_) span.stats.seconds[Stats::Read] += Stats::secondsSince(map_start);
+
+                if (mapped.isOpen())
+                {
+                    auto allocations = AllocationCounter::thisThread();
+
+                    analyzeChunks_
+                    (
+                        mapped.data(),
+                        schedule,
+                        span.firstChunk,
+                        span.lastChunk,
+                        workspace,
+                        destination
+                    );
+
+                    AllocationCounter::expectNone(allocations, "the chunk loop");
+                    return;
+                }
             }
 
-            // Analyze remainder
-            if (has_remainder)
+            // (The file could have gone since checkFile_)
+            std::ifstream raw_audio(in_file, std::ios::binary);
+
+            if (!raw_audio)
             {
-                std::size_t remainder_samples = total_samples - (chunks_count * hop_size);
-                std::vector<std::int16_t> remainder_buffer(fftSize_, 0);
+                span.error = "Unable to open file.";
+                return;
+            }
 
-                raw_audio.read
-                (
-                    reinterpret_cast<char*>(remainder_buffer.data()),
-                    remainder_samples * sizeof(std::int16_t)
-                );
+            auto allocations = AllocationCounter::thisThread();
 
-                auto remainder_start_time = static_cast<float>(chunks_count * hop_size) / SAMPLING_RATE_;
+            analyzeChunks_
+            (
+                raw_audio,
+                span.firstChunk,
+                span.lastChunk,
+                workspace,
+                destination
+            );
 
-                fftAnalyzeChunk_
-                (
-                    remainder_buffer,
-                    remainder_start_time,
-                    static_chunk_start_times,
-                    IsLastChunk_::Yes
-                );
+            AllocationCounter::expectNone(allocations, "the chunk loop");
+        };
+
+    for (auto span_i : order)
+    {
+        pool_->submit
+        (
+            [&, span_i](std::size_t workerIndex)
+            {
+                auto& span = spans[span_i];
+                auto& workspace = *workspaces_[workerIndex];
+
+                // Caught here, since the pool would drop every other queued
+                // span (every other file's too) on the first throw
+                try
+                {
+                    analyze_span(span, workspace);
+                }
+                catch (const std::exception& ex)
+                {
+                    span.error = ex.what();
+                }
+
+                // Flushing here (a partial batch per span, at most) means
+                // the span's bits are all set as soon as it's done
+                flushChunks_(workspace);
+
+                auto file_i = span.fileIndex;
+
+                {
+                    std::lock_guard<std::mutex> lock(spans_mutex);
+                    if (--spans_left[file_i] > 0) return;
+                }
+
+                // (The lock above also makes every span's bits visible here)
+                auto& analysis = analyses[file_i];
+                auto end_span = (file_i + 1 < inFiles.size()) ? first_spans[file_i + 1] : spans.size();
+
+                for (auto i = first_spans[file_i]; i < end_span; ++i)
+                {
+                    analysis.skippedChunksCount += spans[i].skippedChunksCount;
+                    analysis.stats += spans[i].stats;
+
+                    if (analysis.error.empty()) analysis.error = spans[i].error;
+                }
+
+                // Reported like a file that failed without spans: no chunks
+                if (!analysis.error.empty())
+                {
+                    analysis.chunksCount = 0;
+                    analysis.skippedChunksCount = 0;
+                    analysis.staticFrames.reset(0);
+                }
+
+                spectrograms[file_i].reset();
+
+                // (Neighbouring spans read some of the same samples, so count
+                // the file's bytes once)
+                if (stats_)
+                {
+                    analysis.stats.bytes = schedules[file_i].totalSamples * bytesPerSample_;
+                    analysis.stats.samples = schedules[file_i].totalSamples;
+                }
+
+                emitFileDone_(file_i, std::move(analysis));
             }
+        );
+    }
+
+    // (Every file that could be analyzed has at least one chunk, so at least
+    // one span, so they've all been finished by now)
+    pool_->wait();
+}
+
+// Chunks are only queued here, so analysis.staticFrames may not be
+// complete until the workspace is flushed (see finishFile_)
+void AudioAnalyzer::processFile_
+(
+    const std::filesystem::path& inFile,
+    std::size_t fileIndex,
+    Workspace_& workspace,
+    Analysis& analysis,
+    std::unique_ptr<Spectrogram>& spectrogram
+) const
+{
+    analysis = makeAnalysis_(inFile);
+
+    // Bad files are reported in their Analysis, not thrown, so one can't
+    // abort a long list
+    analysis.error = checkFile_(inFile);
+    if (!analysis.error.empty()) return;
+
+    std::error_code ec{};
+    auto file_size = std::filesystem::file_size(inFile, ec);
+
+    if (ec)
+    {
+        analysis.error = ec.message();
+        return;
+    }
+
+    auto& static_frames = analysis.staticFrames; // Eventual product
+    Destination_ destination
+    {
+        fileIndex,
+        &static_frames,
+        &analysis.skippedChunksCount,
+        stats_ ? &analysis.stats : nullptr
+    };
+
+    // Room for every chunk, so recording one never reallocates mid-file
+    auto schedule = schedule_(file_size / bytesPerSample_);
+    static_frames.reset(schedule.framesCount());
+
+    if (!spectrogramPath_.empty())
+    {
+        try
+        {
+            spectrogram = openSpectrogram_(inFile, schedule.framesCount());
+        }
+        catch (const std::exception& ex)
+        {
+            analysis.error = ex.what();
+            return;
         }
 
-        // Aggregate results
-        analyses[i] =
+        destination.spectrogram = spectrogram.get();
+    }
+
+    if (memoryMap_)
+    {
+        auto map_start = stats_ ? Stats::Clock::now() : Stats::Clock::time_point{};
+        MappedFile mapped(inFile);
+
+        if (stats_)
         {
-            in_file,
-            fftSize_,
-            windowType_,
-            overlapDecPercent_,
-            static_cast<float>(fftSize_) / SAMPLING_RATE_,
-            static_chunk_start_times
-        };
+            analysis.stats.seconds[Stats::Read] += Stats::secondsSince(map_start);
+            analysis.stats.bytes += mapped.size();
+            analysis.stats.samples += mapped.size() / bytesPerSample_;
+        }
+
+        if (mapped.isOpen())
+        {
+            // (The file could have changed size since file_size)
+            schedule = schedule_(mapped.size() / bytesPerSample_);
+            static_frames.reset(schedule.framesCount());
+            auto allocations = AllocationCounter::thisThread();
+
+            analysis.chunksCount = analyzeChunks_
+            (
+                mapped.data(),
+                schedule,
+                0,
+                schedule.framesCount(),
+                workspace,
+                destination
+            );
+
+            AllocationCounter::expectNone(allocations, "the chunk loop");
+            return;
+        }
+    }
+
+    // Fall back to reading through a stream (which doesn't need to know the
+    // size up front)
+    std::ifstream raw_audio(inFile, std::ios::binary);
+
+    if (!raw_audio)
+    {
+        analysis.error = "Unable to open file.";
+        return;
+    }
+
+    auto allocations = AllocationCounter::thisThread();
+
+    analysis.chunksCount = analyzeChunks_
+    (
+        raw_audio,
+        0,
+        NO_LAST_CHUNK_,
+        workspace,
+        destination
+    );
+
+    // A file that grew since file_size may have needed more room
+    if (analysis.chunksCount <= schedule.framesCount())
+    {
+        AllocationCounter::expectNone(allocations, "the chunk loop");
     }
 }
 
-void AudioAnalyzer::fftAnalyzeChunk_
+// Called once all of a file's chunks are queued. If none are still waiting
+// in the batch, it's done now; otherwise it's done at the workspace's next
+// flush. Anything settled by earlier flushes goes out first, so files leave
+// a workspace in the order they entered it
+void AudioAnalyzer::finishFile_
 (
-    const std::vector<std::int16_t>& chunk,
-    float segmentStartTimeSeconds,
-    std::vector<float>& staticChunkStartTimes,
-    IsLastChunk_ isLastChunk
-)
+    Workspace_& workspace,
+    std::size_t fileIndex,
+    std::unique_ptr<Analysis> analysis,
+    std::unique_ptr<Spectrogram> spectrogram
+) const
 {
-    prepareInputBuffer_(chunk);
+    emitSettled_(workspace);
 
-    if (isLastChunk == IsLastChunk_::Yes)
+    if (workspace.pending.empty())
     {
-        zeroPadInputBuffer_(chunk);
+        spectrogram.reset();
+        emitFileDone_(fileIndex, std::move(*analysis));
+        return;
     }
 
-    fftwf_execute(fftwPlan_);
+    // (The spectrogram has to outlive the file's queued chunks too)
+    workspace.waiting.push_back({ fileIndex, std::move(analysis), std::move(spectrogram) });
+}
 
-    auto magnitudes = magnitudesFromOutputBuffer_();
+void AudioAnalyzer::emitSettled_(Workspace_& workspace) const
+{
+    if (workspace.settled == 0) return;
 
-    if (haveStatic_(magnitudes))
+    for (std::size_t i = 0; i < workspace.settled; ++i)
     {
-        staticChunkStartTimes.emplace_back(segmentStartTimeSeconds);
+        auto& waiting = workspace.waiting[i];
+        waiting.spectrogram.reset();
+        emitFileDone_(waiting.fileIndex, std::move(*waiting.analysis));
     }
+
+    workspace.waiting.erase(workspace.waiting.begin(), workspace.waiting.begin() + workspace.settled);
+    workspace.settled = 0;
 }
 
-std::streamsize AudioAnalyzer::sizeOf_(std::ifstream& rawAudio) const
+void AudioAnalyzer::emitStaticChunk_(std::size_t fileIndex, float startTimeSeconds) const
 {
-    rawAudio.seekg(0, std::ios::end);
-    std::streamsize raw_audio_size = rawAudio.tellg();
-    rawAudio.seekg(0, std::ios::beg);
-    return raw_audio_size;
+    std::lock_guard<std::mutex> lock(sinkMutex_);
+    sink_->onStaticChunk(fileIndex, startTimeSeconds);
 }
 
-// Copy chunk data into FFT input buffer with scaling and Hann window
-// Add optional windows and an option for none
-void AudioAnalyzer::prepareInputBuffer_(const std::vector<std::int16_t>& chunk)
+void AudioAnalyzer::emitFileDone_(std::size_t fileIndex, Analysis&& analysis) const
 {
+    if (startTimes_) analysis.staticChunkStartTimes = analysis.staticFrames.startTimes();
 
-#if !defined(USE_AVX2)
+    std::lock_guard<std::mutex> lock(sinkMutex_);
+    sink_->onFileDone(fileIndex, std::move(analysis));
+}
 
-    // Checking outside the for loop faster? Negligible, I assume?
-    if (useWindowing_)
+// Why inFile can't be analyzed, or empty if it can. (The Analysis already
+// names the file, so the messages don't)
+std::string AudioAnalyzer::checkFile_(const std::filesystem::path& inFile) const
+{
+    // One stat, instead of one for exists and another for is_regular_file
+    std::error_code ec{};
+    auto status = std::filesystem::status(inFile, ec);
+
+    if (status.type() == std::filesystem::file_type::not_found)
+        return "Does not exist.";
+
+    if (ec)
+        return ec.message();
+
+    if (status.type() != std::filesystem::file_type::regular)
+        return "Not a regular file.";
+
+    return {};
+}
+
+// Where inFile's spectrogram goes: spectrogramPath_ itself if it names a
+// .npy file, otherwise <spectrogramPath_>/<input file name>.npy
+std::filesystem::path AudioAnalyzer::spectrogramFile_(const std::filesystem::path& inFile) const
+{
+    if (spectrogramPath_.extension() == ".npy") return spectrogramPath_;
+
+    auto name = inFile.filename();
+    name += ".npy";
+    return spectrogramPath_ / name;
+}
+
+std::unique_ptr<Spectrogram> AudioAnalyzer::openSpectrogram_
+(
+    const std::filesystem::path& inFile,
+    std::size_t framesCount
+) const
+{
+    return std::make_unique<Spectrogram>
+    (
+        spectrogramFile_(inFile),
+        framesCount,
+        fftSize_,
+        spectrogramFirstBin_,
+        spectrogramEndBin_,
+        spectrogramFormat_
+    );
+}
+
+AudioAnalyzer::Schedule_ AudioAnalyzer::schedule_(std::size_t totalSamples) const
+{
+    Schedule_ schedule{};
+    schedule.totalSamples = totalSamples;
+    schedule.hopSize = hopSize_;
+
+    // Handle edge case where total_samples < fftSize_
+    schedule.chunksCount = (totalSamples > fftSize_)
+        ? (((totalSamples - fftSize_) / schedule.hopSize) + 1)
+        : 1;
+
+    if (schedule.chunksCount < 1)
     {
-        for (std::size_t i = 0; i < chunk.size(); ++i)
-            fftInputBuffer_[i] = chunk[i] * window_[i];
+        throw std::runtime_error("Lol what");
     }
-    else
+
+    // Determine if there's a remainder based on the hop_size. A lone chunk is
+    // already zero-padded, so it never has one
+    schedule.hasRemainder = (schedule.chunksCount > 1)
+        && (totalSamples > (schedule.chunksCount * schedule.hopSize));
+
+    return schedule;
+}
+
+// Analyzes chunks [firstChunk, lastChunk) and records which ones have
+// static. The final chunk may be partial, in which
+// case it's zero-padded.
+//
+// The workspace ring always holds the current chunk, so after the first one
+// only hop_size new samples are read per chunk (no seeking back for overlap).
+// Each sample is read once, memory use doesn't depend on the file's size, and
+// the stream only has to be seekable if firstChunk isn't 0. Where the stream
+// ends decides the chunk count and remainder, the same as schedule_ does
+// from a known size.
+//
+// Returns the number of chunks analyzed
+std::size_t AudioAnalyzer::analyzeChunks_
+(
+    std::istream& rawAudio,
+    std::size_t firstChunk,
+    std::size_t lastChunk,
+    Workspace_& workspace,
+    const Destination_& destination
+) const
+{
+    if (firstChunk >= lastChunk) return 0;
+
+    auto ring = workspace.ring.data();
+    auto hop_size = hopSize_;
+    auto bytes = bytesPerSample_;
+
+    if (firstChunk > 0)
     {
-        for (std::size_t i = 0; i < chunk.size(); ++i)
-            fftInputBuffer_[i] = chunk[i];
+        rawAudio.seekg
+        (
+            static_cast<std::streamoff>(firstChunk * hop_size * bytesPerSample_),
+            std::ios::beg
+        );
     }
 
-#else // defined(USE_AVX2)
-
-    const auto chunk_size = chunk.size();
-    std::size_t i = 0;
+    // Oldest sample of the current chunk
+    std::size_t ring_head = 0;
+    auto chunk_i = firstChunk;
+    auto chunk_samples = readSamples_(rawAudio, ring, fftSize_, destination.stats);
 
-    if (useWindowing_)
+    while (true)
     {
-        // Process 8 elements at a time
-        for (; i + 7 < chunk_size; i += 8)
-        {
-            // Load 8 int16_t values and extend to int32_t
-            auto chunk_vals_16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&chunk[i]));
-            auto chunk_vals = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(chunk_vals_16));
+        auto head_size = std::min(chunk_samples, fftSize_ - ring_head);
+
+        fftAnalyzeChunk_
+        (
+            workspace,
+            { ring + (ring_head * bytes), head_size, ring, chunk_samples - head_size },
+            chunk_i,
+            destination
+        );
 
-            // Load Hann window coefficients
-            auto window_vals = _mm256_loadu_ps(&window_[i]);
+        // A partial chunk (remainder, or a file shorter than one chunk) is
+        // always the last
+        if (++chunk_i >= lastChunk || chunk_samples < fftSize_) return chunk_i - firstChunk;
 
-            // Perform element-wise multiplication
-            auto result = _mm256_mul_ps(chunk_vals, window_vals);
+        // Overwrite the oldest hop_size samples with the next ones
+        auto first_part = std::min(hop_size, fftSize_ - ring_head);
+        auto new_samples = readSamples_(rawAudio, ring + (ring_head * bytes), first_part, destination.stats);
 
-            // Store the results
-            _mm256_storeu_ps(&fftInputBuffer_[i], result);
+        if (new_samples == first_part && first_part < hop_size)
+            new_samples += readSamples_(rawAudio, ring, hop_size - first_part, destination.stats);
+
+        // New samples land where the chunk began, so the next chunk starts
+        // right after them (modulo fftSize_)
+        ring_head = (ring_head + hop_size) % fftSize_;
+
+        if (new_samples < hop_size)
+        {
+            // End of stream. Whatever is left past the next hop is the
+            // remainder, except that a file with only one full chunk never
+            // has one (see schedule_)
+            if (chunk_i == 1) return chunk_i - firstChunk;
+
+            chunk_samples = fftSize_ - hop_size + new_samples;
+            if (chunk_samples == 0) return chunk_i - firstChunk;
         }
     }
-    else // (!useWindowing_)
+}
+
+// Same as above, but straight from memory (mapped file). samples points at the
+// first sample of firstChunk
+std::size_t AudioAnalyzer::analyzeChunks_
+(
+    const unsigned char* samples,
+    const Schedule_& schedule,
+    std::size_t firstChunk,
+    std::size_t lastChunk,
+    Workspace_& workspace,
+    const Destination_& destination
+) const
+{
+    auto hop_size = schedule.hopSize;
+    auto first_sample = firstChunk * hop_size;
+
+    for (std::size_t chunk_i = firstChunk; chunk_i < lastChunk; ++chunk_i)
     {
-        for (; i + 7 < chunk_size; i += 8)
-        {
-            auto chunk_vals_16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&chunk[i]));
-            auto chunk_vals = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(chunk_vals_16));
+        auto chunk_start = chunk_i * hop_size;
+        auto chunk_samples = std::min(fftSize_, schedule.totalSamples - chunk_start);
+
+        fftAnalyzeChunk_
+        (
+            workspace,
+            { samples + ((chunk_start - first_sample) * bytesPerSample_), chunk_samples },
+            chunk_i,
+            destination
+        );
+    }
+
+    return lastChunk - firstChunk;
+}
+
+AudioAnalyzer::Analysis AudioAnalyzer::makeAnalysis_(const std::filesystem::path& inFile) const
+{
+    Analysis analysis
+    {
+        inFile,
+        fftSize_,
+        windowType_,
+        overlapDecPercent_,
+        static_cast<float>(fftSize_) / SAMPLING_RATE_,
+        0,
+        {}
+    };
+
+    analysis.staticFrames = Detections(hopSize_, fftSize_, SAMPLING_RATE_);
+    return analysis;
+}
 
-            // Store the results directly
-            _mm256_storeu_ps(&fftInputBuffer_[i], chunk_vals);
+// Windows the chunk into the next free batch slot. A chunk shorter than
+// fftSize_ is the last one in its file and gets zero-padded. The FFT and
+// static check happen once the batch is full (or flushed). A chunk the
+// energy gate rules out never takes up the slot at all
+void AudioAnalyzer::fftAnalyzeChunk_
+(
+    Workspace_& workspace,
+    const Chunk_& chunk,
+    std::size_t frame,
+    const Destination_& destination
+) const
+{
+    auto chunk_size = chunk.size();
+    auto is_last_chunk = (chunk_size < fftSize_) ? IsLastChunk_::Yes : IsLastChunk_::No;
+    auto input_buffer = workspace.fftInputBuffer + (workspace.pending.size() * inputStride_);
+
+    auto energy = 0.0f;
+
+    {
+        Stats::Timer timer(destination.stats, Stats::Convert, perfCounters_);
+        energy = prepareInputBuffer_(chunk.head, chunk.headSize, input_buffer);
+
+        if (chunk.tailSize)
+        {
+            energy += prepareInputBuffer_(chunk.tail, chunk.tailSize, input_buffer, chunk.headSize);
         }
     }
 
-    // Process remaining elements
-    if (useWindowing_)
+    // (Zero padding adds no energy, so this can go before it)
+    if (energy < energyGate_ && !needMagnitudes_)
     {
-        for (; i < chunk_size; ++i)
-            fftInputBuffer_[i] = chunk[i] * window_[i];
+        if (destination.skippedChunks) ++*destination.skippedChunks;
+        return;
     }
-    else
+
+    if (is_last_chunk == IsLastChunk_::Yes)
     {
-        for (; i < chunk_size; ++i)
-            fftInputBuffer_[i] = chunk[i];
+        zeroPadInputBuffer_(chunk_size, input_buffer);
     }
 
-#endif // !defined(USE_AVX2)
+    workspace.pending.push_back({ destination, frame });
 
+    if (workspace.pending.size() == workspace.batchSize)
+    {
+        flushChunks_(workspace);
+    }
 }
 
-// Zero-pad the remainder of the buffer if the chunk is smaller than
-// fftSize_ (which I would assume is almost always the case)
-void AudioAnalyzer::zeroPadInputBuffer_(const std::vector<std::int16_t>& chunk)
+// Transforms and checks every chunk queued in the workspace's batch
+void AudioAnalyzer::flushChunks_(Workspace_& workspace) const
 {
+    auto count = workspace.pending.size();
+    if (count == 0) return;
 
-#if !defined(USE_AVX2)
+    // A batch can hold chunks from several files, so its time (and counts)
+    // are split evenly between its chunks' files
+    auto perf_start = perfCounters_ ? PerfCounters::read() : PerfCounters::Values{};
+    auto stage_start = stats_ ? Stats::Clock::now() : Stats::Clock::time_point{};
 
-    std::fill
-    (
-        fftInputBuffer_ + chunk.size(),
-        fftInputBuffer_ + fftSize_,
-        0.0f
-    );
+    auto add_stage = [this, &workspace, &stage_start, &perf_start, count](Stats::Stage stage)
+        {
+            auto seconds_per_chunk = Stats::secondsSince(stage_start) / count;
+            PerfCounters::Values perf_per_chunk{};
 
-#else // defined(USE_AVX2)
+            if (perfCounters_)
+            {
+                auto perf_end = PerfCounters::read();
+                perf_per_chunk = perf_end;
+                perf_per_chunk -= perf_start;
+                for (auto& value : perf_per_chunk.counts) value /= count;
+                perf_start = perf_end;
+            }
+
+            for (auto& pending : workspace.pending)
+            {
+                if (!pending.destination.stats) continue;
+
+                pending.destination.stats->seconds[stage] += seconds_per_chunk;
+                pending.destination.stats->perf[stage] += perf_per_chunk;
+            }
+
+            stage_start = Stats::Clock::now();
+        };
 
-    auto zero_vec = _mm256_setzero_ps();
-    std::size_t j = chunk.size();
-    for (; j + 7 < fftSize_; j += 8)
+    // New-array execute, so every workspace can share the plans. A partial
+    // batch runs the single-chunk plan per slot instead
+    if (count == batchSize_ && fftwBatchPlan_)
     {
-        _mm256_storeu_ps(&fftInputBuffer_[j], zero_vec);
+        fftwf_execute_split_dft_r2c
+        (
+            fftwBatchPlan_,
+            workspace.fftInputBuffer,
+            workspace.spectrum,
+            workspace.spectrum + imagOffset_
+        );
     }
+    else
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            fftwf_execute_split_dft_r2c
+            (
+                fftwPlan_,
+                workspace.fftInputBuffer + (i * inputStride_),
+                workspace.spectrum + (i * outputStride_),
+                workspace.spectrum + (i * outputStride_) + imagOffset_
+            );
+        }
+    }
+
+    if (stats_) add_stage(Stats::Fft);
 
-    // Process remaining elements
-    for (; j < fftSize_; ++j)
+    for (std::size_t i = 0; i < count; ++i)
     {
-        fftInputBuffer_[j] = 0.0f;
+        auto real = workspace.spectrum + (i * outputStride_);
+        auto imag = real + imagOffset_;
+        auto have_static = false;
+
+        if (needMagnitudes_)
+        {
+            magnitudesFromOutputBuffer_(real, imag, workspace.magnitudes);
+            have_static = haveStatic_(workspace.magnitudes);
+
+            auto& destination = workspace.pending[i].destination;
+
+            if (destination.spectrogram)
+                destination.spectrogram->write(workspace.pending[i].frame, workspace.magnitudes);
+        }
+        else
+        {
+            have_static = haveStaticFused_(real, imag);
+        }
+
+        if (have_static)
+        {
+            auto& pending = workspace.pending[i];
+            auto& destination = pending.destination;
+
+            if (destination.staticFrames) destination.staticFrames->set(pending.frame);
+
+            emitStaticChunk_
+            (
+                destination.fileIndex,
+                static_cast<float>(pending.frame * hopSize_) / SAMPLING_RATE_
+            );
+        }
     }
 
-#endif // !defined(USE_AVX2)
+    if (stats_) add_stage(Stats::Detect);
+
+    workspace.pending.clear();
 
+    // Every file waiting on this batch is complete now
+    workspace.settled = workspace.waiting.size();
 }
 
-// Analyze FFT output (magnitude calculation for each frequency bin)
-std::vector<float> AudioAnalyzer::magnitudesFromOutputBuffer_() const
+void AudioAnalyzer::discardChunks_()
 {
-    std::vector<float> magnitudes(numFrequencyBins_);
-
-#if !defined(USE_AVX2)
-
-    for (std::size_t k = 0; k < numFrequencyBins_; ++k)
+    for (auto& workspace : workspaces_)
     {
-        auto real = fftOutputBuffer_[k][0];
-        auto imag = fftOutputBuffer_[k][1];
-        magnitudes[k] = std::sqrt((real * real) + (imag * imag));
+        workspace->pending.clear();
+        workspace->waiting.clear();
+        workspace->settled = 0;
     }
+}
 
-#else // defined(USE_AVX2)
+// Returns the number of whole samples read (short only at end of stream,
+// where a partial sample is dropped)
+std::size_t AudioAnalyzer::readSamples_
+(
+    std::istream& rawAudio,
+    unsigned char* samples,
+    std::size_t count,
+    Stats::Counters* stats
+) const
+{
+    Stats::Timer timer(stats, Stats::Read);
 
-    std::size_t k = 0;
-    for (; k + 7 < numFrequencyBins_; k += 8)
+    rawAudio.read
+    (
+        reinterpret_cast<char*>(samples),
+        static_cast<std::streamsize>(count * bytesPerSample_)
+    );
+
+    auto bytes = static_cast<std::size_t>(rawAudio.gcount());
+    auto samples_read = bytes / bytesPerSample_;
+
+    if (stats)
     {
-        auto real_vals = _mm256_loadu_ps(&fftOutputBuffer_[k][0]);
-        auto imag_vals = _mm256_loadu_ps(&fftOutputBuffer_[k][1]);
+        stats->bytes += bytes;
+        stats->samples += samples_read;
+    }
+
+    return samples_read;
+}
 
-        auto real_sq = _mm256_mul_ps(real_vals, real_vals);
-        auto imag_sq = _mm256_mul_ps(imag_vals, imag_vals);
+// Copy chunk data into FFT input buffer with scaling and Hann window
+// Add optional windows and an option for none
+//
+// The samples are decoded on the way in, by the kernels for sampleFormat_.
+// offset is where in the FFT input (and window) the chunk's samples go, for
+// chunks that come in more than one piece
+//
+// Returns the energy (sum of squares) of what went into the buffer
+float AudioAnalyzer::prepareInputBuffer_
+(
+    const unsigned char* chunk,
+    std::size_t chunkSize,
+    float* fftInputBuffer,
+    std::size_t offset
+) const
+{
+    fftInputBuffer += offset;
 
-        auto magnitude = _mm256_sqrt_ps(_mm256_add_ps(real_sq, imag_sq));
-        _mm256_storeu_ps(&magnitudes[k], magnitude);
+    // The usual case, a whole frame in one piece
+    if (frameConverts_ && offset == 0 && chunkSize == fftSize_)
+    {
+        if (useWindowing_)
+            return frameConverts_->convertWindowed(chunk, window_->data(), fftInputBuffer);
+        else
+            return frameConverts_->convert(chunk, fftInputBuffer);
     }
 
-    // Process remaining elements
-    for (; k < numFrequencyBins_; ++k)
+    // Checking outside the loop keeps the branch out of the kernels
+    if (useWindowing_)
     {
-        auto real = fftOutputBuffer_[k][0];
-        auto imag = fftOutputBuffer_[k][1];
-        magnitudes[k] = std::sqrt((real * real) + (imag * imag));
+        return converts_->convertWindowed(chunk, window_->data() + offset, chunkSize, fftInputBuffer);
     }
+    else
+    {
+        return converts_->convert(chunk, chunkSize, fftInputBuffer);
+    }
+}
 
-#endif // !defined(USE_AVX2)
+// Zero-pad the remainder of the buffer if the chunk is smaller than
+// fftSize_ (which I would assume is almost always the case)
+void AudioAnalyzer::zeroPadInputBuffer_(std::size_t chunkSize, float* fftInputBuffer) const
+{
+    kernels_->zero(fftInputBuffer + chunkSize, fftSize_ - chunkSize);
+}
 
-    return magnitudes;
+// Analyze FFT output (magnitude calculation for each frequency bin)
+void AudioAnalyzer::magnitudesFromOutputBuffer_
+(
+    const float* real,
+    const float* imag,
+    float* magnitudes
+) const
+{
+    if (frameKernels_)
+        frameKernels_->magnitudes(real, imag, magnitudes);
+    else
+        kernels_->magnitudes(real, imag, numFrequencyBins_, magnitudes);
 }
 
-bool AudioAnalyzer::haveStatic_(const std::vector<float>& magnitudes) const
+bool AudioAnalyzer::haveStatic_(const float* magnitudes) const
 {
     return std::all_of
     (
-        magnitudes.begin(),
-        magnitudes.end(),
-        [](float mag)
-        {
-            // Static detection logic placeholder (to be implemented later)
-            // For now, we assume a simple placeholder threshold
-            constexpr auto static_threshold = 1000.0f;
-            // ^ ALTHOUGH, maybe seems to be working well for a placeholder?
-            return mag > static_threshold;
-        }
+        magnitudes,
+        magnitudes + numFrequencyBins_,
+        [](float mag) { return mag > STATIC_THRESHOLD_; }
     );
 }
+
+// Same verdict as haveStatic_(magnitudesFromOutputBuffer_()), without the
+// vector or the square roots. Magnitudes and the threshold are non-negative,
+// so (sqrt(re^2 + im^2) > t) is (re^2 + im^2 > t^2), and one quiet bin is
+// enough to rule a chunk out. Speech usually fails within the first few bins
+bool AudioAnalyzer::haveStaticFused_(const float* real, const float* imag) const
+{
+    constexpr auto threshold_sq = STATIC_THRESHOLD_ * STATIC_THRESHOLD_;
+
+    if (frameKernels_) return frameKernels_->allAbove(real, imag, threshold_sq);
+
+    return kernels_->allAbove(real, imag, numFrequencyBins_, threshold_sq);
+}
@@ -1,6 +1,13 @@
 #pragma once
 
+#include "Detections.h"
+#include "Samples.h"
+#include "Simd.h"
+#include "Spectrogram.h"
+#include "Stats.h"
+#include "WindowRegistry.h"
 #include "Windowing.h"
+#include "Wisdom.h"
 
 #include "fftw3.h"
 
@@ -8,15 +15,25 @@
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <ostream>
+#include <string>
 #include <vector>
 
+class WorkStealingPool;
+
 class AudioAnalyzer
 {
 public:
     // FFT size represents the number of samples in a chunk (2048 bytes with
     // std::int16_t)
     static constexpr const std::size_t DEFAULT_FFT_SIZE = 1024;
+    static constexpr const std::size_t DEFAULT_THREADS = 1;
+    static constexpr const std::size_t DEFAULT_BATCH_SIZE = 16;
+    static constexpr const std::size_t DEFAULT_PREFETCH = 4;
 
     struct Analysis
     {
@@ -24,17 +41,129 @@ public:
         std::size_t fftSize = 0;
         Windowing::Window windowType = Windowing::None;
         float overlapDecPercent = 0.0f;
-        // Error code (instead of throwing on bad files)?
 
         // FFT size determines the time resolution of static detection
         float chunkDurationSeconds = 0.0f;
 
-        // Start times (in seconds) of detected static chunks
-        std::vector<float> staticChunkStartTimes{};
+        // Number of chunks analyzed (including a zero-padded remainder)
+        std::size_t chunksCount = 0;
+
+        // How many of those the energy gate ruled out without an FFT
+        std::size_t skippedChunksCount = 0;
+
+        // Which chunks had static (a bit each), and the intervals they cover
+        Detections staticFrames{};
+
+        // Start times (in seconds) of detected static chunks. Only filled
+        // with Config::startTimes; staticFrames has the same thing in a
+        // fraction of the memory
+        std::optional<std::vector<float>> staticChunkStartTimes{};
+
+        // Why the file couldn't be analyzed (missing, not a regular file,
+        // unreadable), or empty if it was. A file that fails doesn't stop
+        // the rest; it just gets this and no chunks
+        std::string error{};
+
+        // Bytes read and time per stage, with Config::stats (zeros otherwise)
+        Stats::Counters stats{};
 
         friend std::ostream& operator<<(std::ostream&, const Analysis&);
     };
 
+    // Receives results as they're produced, instead of all at once at the
+    // end. Calls are never concurrent (but come from worker threads when
+    // threads != 1)
+    class Sink
+    {
+    public:
+        virtual ~Sink() = default;
+
+        // Each static chunk, as soon as it's transformed. This is on the hot
+        // path, so keep it cheap. Within a file, chunks arrive in time order,
+        // except with splitFiles (where each span's arrive together)
+        virtual void onStaticChunk(std::size_t fileIndex, float startTimeSeconds)
+        {
+            (void)fileIndex;
+            (void)startTimeSeconds;
+        }
+
+        // Once per file, after all its chunks, with its complete Analysis.
+        // Files finish in whatever order they finish in, not input order
+        virtual void onFileDone(std::size_t fileIndex, Analysis&& analysis) = 0;
+    };
+
+    struct Config
+    {
+        std::size_t fftSize = DEFAULT_FFT_SIZE;
+        Windowing::Window windowType = DEFAULT_WINDOW;
+        float overlap = DEFAULT_OVERLAP;
+        std::filesystem::path wisdomPath{};
+
+        // Number of files analyzed concurrently. 0 means one per hardware
+        // thread, 1 keeps everything on the calling thread
+        std::size_t threads = DEFAULT_THREADS;
+
+        // Also split each file's chunks into spans that run on separate
+        // threads (for long recordings). Only matters with threads != 1
+        bool splitFiles = false;
+
+        // Read files through a memory map (falling back to a stream if the
+        // map fails) instead of an ifstream
+        bool memoryMap = true;
+
+        // Number of chunks windowed into one block and transformed with a
+        // single FFTW call. Chunks from consecutive (short) files share
+        // batches
+        std::size_t batchSize = DEFAULT_BATCH_SIZE;
+
+        // How many files ahead of the analysis to have the OS start reading
+        // (see Prefetcher). 0 turns it off
+        std::size_t prefetch = DEFAULT_PREFETCH;
+
+        // Kernel set for converting, windowing and checking chunks. Auto
+        // picks the best one the CPU supports
+        Simd::Level simd = Simd::Auto;
+
+        // How hard FFTW tries when planning. New plans are merged into the
+        // wisdom file (if there is one)
+        Wisdom::Planner planner = Wisdom::Auto;
+
+        // Skip the FFT for chunks too quiet to possibly have static (see
+        // energyGate_). Never changes the results
+        bool energyGate = true;
+
+        // Time each stage into Analysis::stats (see Stats). Off, each timing
+        // point costs a null check
+        bool stats = false;
+
+        // Also count cycles, instructions, cache and branch misses for the
+        // convert, FFT and detect stages (see PerfCounters). Only with stats
+        bool perfCounters = false;
+
+        // Also list each static chunk's start time in the Analysis (see
+        // Analysis::staticChunkStartTimes)
+        bool startTimes = false;
+
+        // Also write every chunk's magnitudes to a .npy file per input (see
+        // Spectrogram and spectrogramFile_). A path ending in .npy is the
+        // file itself (for a single input); anything else is a directory that
+        // gets <input file name>.npy for each. Every chunk then needs its
+        // FFT, so this turns the energy gate off
+        std::filesystem::path spectrogramPath{};
+        Spectrogram::Format spectrogramFormat = Spectrogram::Float32;
+
+        // Only bins [spectrogramFirstBin, spectrogramEndBin) are written. An
+        // end of 0 means through the last bin (fftSize / 2)
+        std::size_t spectrogramFirstBin = 0;
+        std::size_t spectrogramEndBin = 0;
+
+        // How the input's samples are encoded (see Samples). Every file, and
+        // live input, is taken to be the same
+        Samples::Format sampleFormat = Samples::Int16;
+    };
+
+    explicit AudioAnalyzer(const Config& config);
+
     AudioAnalyzer
     (
         std::size_t fftSize = DEFAULT_FFT_SIZE,
@@ -46,16 +175,69 @@ public:
     explicit AudioAnalyzer(const std::filesystem::path& wisdomPath);
     virtual ~AudioAnalyzer();
 
+    // The kernel set actually in use (never Auto)
+    Simd::Level simd() const noexcept { return simd_; }
+
+    std::size_t threads() const noexcept { return threads_; }
+
+    // How long construction spent planning (including loading and saving
+    // wisdom), and how much of that was loading it
+    double planSeconds() const noexcept { return planSeconds_; }
+    double wisdomLoadSeconds() const noexcept { return wisdomLoadSeconds_; }
+
+    // Results go to sink as each file finishes. fileIndex is the file's
+    // index in inFiles. Files that can't be analyzed still get an Analysis
+    // (with its error set)
+    void process(const std::vector<std::filesystem::path>& inFiles, Sink& sink);
+
+    // Convenience adapters that collect everything first
     Analysis process(const std::filesystem::path& inFile);
     std::vector<Analysis> process(const std::vector<std::filesystem::path>& inFiles);
 
+    // Live mode, for input that arrives over time (stdin, a FIFO). Each chunk
+    // is analyzed as soon as its last hop of samples has been read and goes
+    // to sink.onStaticChunk right then. Start times aren't collected, so
+    // memory stays constant however long the stream runs (the Analysis
+    // passed to onFileDone at end of stream has none). The trailing partial
+    // chunk is analyzed (zero-padded) at end of stream. name is only used
+    // for the Analysis's file field, and fileIndex is always 0
+    void processStream
+    (
+        std::istream& rawAudio,
+        const std::filesystem::path& name,
+        Sink& sink
+    );
+
 private:
-    // Would it be fine to just use singleton and set benching on/off, or would
-    // the added function calls (which aren't present when the macros are
-    // no-ops) add up?
-    //DX_BENCH(AudioAnalyzer); // Shut up, Intellisense
+    // (Stage timings, which DX_BENCH used to do at compile time, are Stats
+    // now, switched on at run time with Config::stats)
 
     std::size_t fftSize_;
+    std::size_t hopSize_ = 0;
+    std::size_t threads_;
+    bool splitFiles_;
+    bool memoryMap_;
+    std::size_t prefetch_;
+    bool stats_;
+    bool perfCounters_;
+    bool startTimes_;
+    std::filesystem::path spectrogramPath_;
+    Spectrogram::Format spectrogramFormat_;
+    std::size_t spectrogramFirstBin_;
+    std::size_t spectrogramEndBin_;
+    Samples::Format sampleFormat_;
+    std::size_t bytesPerSample_;
+    Simd::Level simd_;
+    const Simd::Kernels* kernels_;
+
+    // Whole-frame kernels specialized for fftSize_, if it's one of
+    // Simd::FIXED_FFT_SIZES (null otherwise)
+    const Simd::FrameKernels* frameKernels_;
+
+    // The converts for sampleFormat_, from the two above (the frame ones
+    // null without frameKernels_)
+    const Simd::ConvertKernels* converts_;
+    const Simd::FrameConvertKernels* frameConverts_;
 
     // Adjustable?
     static constexpr auto SAMPLING_RATE_ = 8000.0f;
@@ -77,7 +259,9 @@ private:
     float overlapDecPercent_;
     Windowing::Window windowType_;
     bool useWindowing_ = true;
-    std::vector<float> window_{};
+
+    // Shared with every other analyzer using the same window
+    std::shared_ptr<const WindowTable> window_{};
 
     void initWindow_();
 
@@ -86,15 +270,106 @@ private:
     //--------------------------------------------------------------------------
 
 private:
+    // Where a file's (or span's) static chunks go. Every one is reported to
+    // the sink; staticFrames also gets its bit set, unless null.
+    // skippedChunks (unless null) counts chunks the energy gate skipped,
+    // stats (null unless stats_) gets the time spent on them, and
+    // spectrogram (unless null) gets each chunk's magnitudes
+    struct Destination_
+    {
+        std::size_t fileIndex = 0;
+        Detections* staticFrames = nullptr;
+        std::size_t* skippedChunks = nullptr;
+        Stats::Counters* stats = nullptr;
+        Spectrogram* spectrogram = nullptr;
+    };
+
+    // Everything a thread needs to analyze a chunk on its own. The plans are
+    // shared (fftwf_execute_split_dft_r2c is thread-safe), but each workspace
+    // gets its own FFTW-aligned buffers to run them on.
+    //
+    // The buffers hold a whole batch: chunk i's input starts at
+    // (i * inputStride_) and its output at (i * outputStride_). The output is
+    // split into a real plane and, imagOffset_ floats after it, an imaginary
+    // plane, so the kernels after the FFT can load whole vectors of either
+    // without shuffling
+    struct Workspace_
+    {
+        // A chunk waiting in the batch, and where it's recorded if it turns
+        // out to have static
+        struct Pending
+        {
+            Destination_ destination{};
+            std::size_t frame = 0;
+        };
+
+        // A file whose chunks have all been queued, but not all flushed
+        struct Waiting
+        {
+            std::size_t fileIndex = 0;
+            std::unique_ptr<Analysis> analysis{};
+            std::unique_ptr<Spectrogram> spectrogram{};
+        };
+
+        float* fftInputBuffer = nullptr;
+        float* spectrum = nullptr;
+        float* magnitudes = nullptr; // One chunk's worth, when needMagnitudes_
+        std::vector<Pending> pending{};
+
+        // Chunks queued before a flush (batchSize_, except in live mode)
+        std::size_t batchSize = 0;
+
+        // The first `settled` waiting files have had every chunk flushed,
+        // and can go to the sink (which happens outside the chunk loop)
+        std::vector<Waiting> waiting{};
+        std::size_t settled = 0;
+
+        // Sliding window over the last fftSize_ samples (still encoded), for
+        // streamed input
+        std::vector<unsigned char> ring{};
+
+        Workspace_
+        (
+            std::size_t ringBytes,
+            std::size_t inputStride,
+            std::size_t outputStride,
+            std::size_t numFrequencyBins,
+            std::size_t batchSize
+        );
+        ~Workspace_();
+
+        Workspace_(const Workspace_&) = delete;
+        Workspace_& operator=(const Workspace_&) = delete;
+    };
+
     std::filesystem::path wisdomPath_;
+    Wisdom::Planner planner_;
+    double planSeconds_ = 0.0;
+    double wisdomLoadSeconds_ = 0.0;
 
     std::size_t numFrequencyBins_ = 0;
-    float* fftInputBuffer_ = nullptr;
-    fftwf_complex* fftOutputBuffer_ = nullptr;
+    std::size_t batchSize_;
+
+    // Batch slots are rounded up to 64 bytes, so every slot has the planning
+    // buffers' alignment and the single-chunk plan can run on any of them
+    std::size_t inputStride_ = 0;
+    std::size_t outputStride_ = 0;
+
+    // Where a slot's imaginary plane starts, relative to its real one. FFTW's
+    // new-array execute needs this to be the same for every buffer a plan
+    // runs on, so it can't depend on the batch size (or the allocator)
+    std::size_t imagOffset_ = 0;
+
     fftwf_plan fftwPlan_ = nullptr;
+    fftwf_plan fftwBatchPlan_ = nullptr; // Only when batchSize_ > 1
+
+    // One per thread. The first also serves as the planning buffers
+    std::vector<std::unique_ptr<Workspace_>> workspaces_{};
+    std::unique_ptr<WorkStealingPool> pool_{};
 
     void initFftw_();
     void freeFftw_();
+    void initWorkers_();
 
     //--------------------------------------------------------------------------
     // Processing
@@ -107,24 +382,181 @@ private:
         Yes
     };
 
-    void process_
+    // A chunk's samples, in order (still encoded; sizes are in samples).
+    // Chunks read from the ring buffer may wrap around its end, so they come
+    // in two pieces
+    struct Chunk_
+    {
+        const unsigned char* head = nullptr;
+        std::size_t headSize = 0;
+        const unsigned char* tail = nullptr;
+        std::size_t tailSize = 0;
+
+        std::size_t size() const noexcept { return headSize + tailSize; }
+    };
+
+    // Chunk layout of one file. Chunk i starts at sample (i * hopSize), and a
+    // remainder is just one more (zero-padded) chunk on the end, so any range
+    // of chunks can be analyzed independently of the others
+    struct Schedule_
+    {
+        std::size_t totalSamples = 0;
+        std::size_t hopSize = 0;
+        std::size_t chunksCount = 0;
+        bool hasRemainder = false;
+
+        std::size_t framesCount() const noexcept { return chunksCount + (hasRemainder ? 1 : 0); }
+    };
+
+    // Static detection logic placeholder (to be implemented later). For now,
+    // a chunk has static if every bin's magnitude is above this
+    static constexpr auto STATIC_THRESHOLD_ = 1000.0f;
+    // ^ ALTHOUGH, maybe seems to be working well for a placeholder?
+
+    // Modes that want the actual magnitudes (not just the static verdict) go
+    // through magnitudesFromOutputBuffer_ and haveStatic_. Everything else
+    // uses haveStaticFused_
+    bool needMagnitudes_ = false;
+
+    // A chunk with static has every bin above the threshold, and (the real
+    // FFT being conjugate-symmetric) so does every bin of the full N-point
+    // DFT. By Parseval, its windowed energy (sum of x^2, which is
+    // sum |X|^2 / N) is then above STATIC_THRESHOLD_^2. Chunks whose energy
+    // isn't even half that skip the FFT. The 2x margin covers rounding in
+    // both the float energy sum (under N * 2^-24 relative) and the FFT
+    // (O(log N * 2^-24)), which is why it's off for absurdly large FFT
+    // sizes. 0 means off
+    float energyGate_ = 0.0f;
+    static constexpr std::size_t MAX_GATED_FFT_SIZE_ = std::size_t(1) << 20;
+
+    // Don't bother splitting files into spans smaller than this. Spans are
+    // always whole words of Detections bits, so threads never share a word
+    static constexpr std::size_t MIN_SPAN_CHUNKS_ = 256;
+
+    // Analyze until the stream ends
+    static constexpr auto NO_LAST_CHUNK_ = static_cast<std::size_t>(-1);
+
+    // Where results go during a process call
+    Sink* sink_ = nullptr;
+    mutable std::mutex sinkMutex_{};
+
+    // Runs several of these over the same files (see Feed_)
+    friend class MultiAnalyzer;
+
+    // A file handed over a block of samples at a time (shared with analyzers
+    // of other configurations), instead of read here. Chunks are analyzed on
+    // the first workspace as soon as a block covers them, so whatever threads
+    // was, this analyzer should only be used by one thread at a time
+    struct Feed_
+    {
+        Analysis analysis{};
+        Schedule_ schedule{};
+        std::size_t nextChunk = 0;
+    };
+
+    void process_(const std::vector<std::filesystem::path>& inFiles);
+
+    void beginFeed_(Feed_& feed, const std::filesystem::path& name, std::size_t totalSamples) const;
+
+    std::size_t feed_
     (
-        std::vector<Analysis>& analyses,
-        const std::vector<std::filesystem::path>& inFiles
+        Feed_& feed,
+        const unsigned char* samples,
+        std::size_t firstSample,
+        std::size_t endSample,
+        std::size_t fileIndex,
+        Sink& sink
     );
 
+    void truncateFeed_(Feed_& feed, std::size_t totalSamples) const;
+    void endFeed_(Feed_& feed, std::size_t fileIndex, Sink& sink);
+
+    void processFile_
+    (
+        const std::filesystem::path& inFile,
+        std::size_t fileIndex,
+        Workspace_& workspace,
+        Analysis& analysis,
+        std::unique_ptr<Spectrogram>& spectrogram
+    ) const;
+
+    void processFiles_(const std::vector<std::filesystem::path>& inFiles);
+    void processSpans_(const std::vector<std::filesystem::path>& inFiles);
+
+    void finishFile_
+    (
+        Workspace_& workspace,
+        std::size_t fileIndex,
+        std::unique_ptr<Analysis> analysis,
+        std::unique_ptr<Spectrogram> spectrogram
+    ) const;
+
+    void emitSettled_(Workspace_& workspace) const;
+    void emitStaticChunk_(std::size_t fileIndex, float startTimeSeconds) const;
+    void emitFileDone_(std::size_t fileIndex, Analysis&& analysis) const;
+
+    std::string checkFile_(const std::filesystem::path& inFile) const;
+    Schedule_ schedule_(std::size_t totalSamples) const;
+
+    std::filesystem::path spectrogramFile_(const std::filesystem::path& inFile) const;
+
+    std::unique_ptr<Spectrogram> openSpectrogram_
+    (
+        const std::filesystem::path& inFile,
+        std::size_t framesCount
+    ) const;
+
+    std::size_t analyzeChunks_
+    (
+        std::istream& rawAudio,
+        std::size_t firstChunk,
+        std::size_t lastChunk,
+        Workspace_& workspace,
+        const Destination_& destination
+    ) const;
+
+    std::size_t analyzeChunks_
+    (
+        const unsigned char* samples,
+        const Schedule_& schedule,
+        std::size_t firstChunk,
+        std::size_t lastChunk,
+        Workspace_& workspace,
+        const Destination_& destination
+    ) const;
+
+    Analysis makeAnalysis_(const std::filesystem::path& inFile) const;
+
     void fftAnalyzeChunk_
     (
-        const std::vector<std::int16_t>& chunk,
-        float segmentStartTimeSeconds,
-        std::vector<float>& staticChunkStartTimes,
-        IsLastChunk_ isLastChunk = {}
-    );
+        Workspace_& workspace,
+        const Chunk_& chunk,
+        std::size_t frame,
+        const Destination_& destination
+    ) const;
+
+    void flushChunks_(Workspace_& workspace) const;
+    void discardChunks_();
+
+    std::size_t readSamples_
+    (
+        std::istream& rawAudio,
+        unsigned char* samples,
+        std::size_t count,
+        Stats::Counters* stats = nullptr
+    ) const;
+
+    float prepareInputBuffer_
+    (
+        const unsigned char* chunk,
+        std::size_t chunkSize,
+        float* fftInputBuffer,
+        std::size_t offset = 0
+    ) const;
 
-    std::streamsize sizeOf_(std::ifstream& rawAudio) const;
-    void prepareInputBuffer_(const std::vector<std::int16_t>& chunk);
-    void zeroPadInputBuffer_(const std::vector<std::int16_t>& chunk);
-    std::vector<float> magnitudesFromOutputBuffer_() const;
-    bool haveStatic_(const std::vector<float>& magnitudes) const;
+    void zeroPadInputBuffer_(std::size_t chunkSize, float* fftInputBuffer) const;
+    void magnitudesFromOutputBuffer_(const float* real, const float* imag, float* magnitudes) const;
+    bool haveStatic_(const float* magnitudes) const;
+    bool haveStaticFused_(const float* real, const float* imag) const;
 
 }; // class AudioAnalyzer
@@ -0,0 +1,187 @@
+#include "Detections.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit (word != 0). One tzcnt/bsf
+static std::size_t lowestSetBit_(std::uint64_t word) noexcept
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward64(&index, word);
+    return index;
+#else
+    return static_cast<std::size_t>(__builtin_ctzll(word));
+#endif
+}
+
+Detections::Detections(std::size_t hopSize, std::size_t fftSize, float samplingRate)
+    : hopSize_(std::max(std::size_t(1), hopSize))
+    , fftSize_(std::max(std::size_t(1), fftSize))
+    , samplingRate_(samplingRate)
+{
+}
+
+void Detections::reset(std::size_t framesCount)
+{
+    framesCount_ = framesCount;
+    words_.assign((framesCount + FRAMES_PER_WORD - 1) / FRAMES_PER_WORD, 0);
+}
+
+std::size_t Detections::count() const noexcept
+{
+    std::size_t count = 0;
+
+    // (A popcnt per word, where the target has it)
+    for (auto word : words_)
+        count += std::bitset<FRAMES_PER_WORD>(word).count();
+
+    return count;
+}
+
+std::vector<Detections::Interval> Detections::intervals() const
+{
+    std::vector<Interval> intervals{};
+
+    forEachInterval_
+    (
+        [this, &intervals](std::size_t firstFrame, std::size_t endFrame, std::size_t startSample, std::size_t endSample)
+        {
+            intervals.push_back
+            (
+                {
+                    firstFrame,
+                    endFrame,
+                    static_cast<float>(startSample) / samplingRate_,
+                    static_cast<float>(endSample) / samplingRate_
+                }
+            );
+        }
+    );
+
+    return intervals;
+}
+
+double Detections::staticSeconds() const noexcept
+{
+    std::size_t samples = 0;
+
+    forEachInterval_
+    (
+        [&samples](std::size_t, std::size_t, std::size_t startSample, std::size_t endSample)
+        {
+            samples += endSample - startSample;
+        }
+    );
+
+    return samples / static_cast<double>(samplingRate_);
+}
+
+double Detections::longestIntervalSeconds() const noexcept
+{
+    std::size_t samples = 0;
+
+    forEachInterval_
+    (
+        [&samples](std::size_t, std::size_t, std::size_t startSample, std::size_t endSample)
+        {
+            samples = std::max(samples, endSample - startSample);
+        }
+    );
+
+    return samples / static_cast<double>(samplingRate_);
+}
+
+std::vector<float> Detections::startTimes() const
+{
+    std::vector<float> times{};
+    times.reserve(count());
+
+    for (std::size_t i = 0; i < words_.size(); ++i)
+    {
+        // Peel off the set bits, lowest first
+        for (auto word = words_[i]; word != 0; word &= word - 1)
+            times.push_back(frameStartSeconds((i * FRAMES_PER_WORD) + lowestSetBit_(word)));
+    }
+
+    return times;
+}
+
+void Detections::grow_(std::size_t framesCount)
+{
+    framesCount_ = framesCount;
+    words_.resize((framesCount + FRAMES_PER_WORD - 1) / FRAMES_PER_WORD, 0);
+}
+
+// Finds runs of set bits a word at a time: from inside a run, the next clear
+// bit ends it; from outside, the next set bit starts one. Each is one
+// lowestSetBit_, and words that are all clear (or all set, mid-run) are
+// skipped whole. Runs whose frames overlap in time are merged before
+// callback(firstFrame, endFrame, startSample, endSample) sees them
+template <typename Callback>
+void Detections::forEachInterval_(Callback callback) const
+{
+    auto have_interval = false;
+    std::size_t first_frame = 0;
+    std::size_t end_frame = 0;
+    std::size_t start_sample = 0;
+    std::size_t end_sample = 0;
+
+    auto add_run = [&](std::size_t runStart, std::size_t runEnd)
+        {
+            auto run_start_sample = runStart * hopSize_;
+            auto run_end_sample = ((runEnd - 1) * hopSize_) + fftSize_;
+
+            if (have_interval && run_start_sample <= end_sample)
+            {
+                end_frame = runEnd;
+                end_sample = run_end_sample;
+                return;
+            }
+
+            if (have_interval) callback(first_frame, end_frame, start_sample, end_sample);
+
+            have_interval = true;
+            first_frame = runStart;
+            end_frame = runEnd;
+            start_sample = run_start_sample;
+            end_sample = run_end_sample;
+        };
+
+    auto in_run = false;
+    std::size_t run_start = 0;
+
+    for (std::size_t i = 0; i < words_.size(); ++i)
+    {
+        auto word = words_[i];
+        std::size_t bit = 0;
+
+        while (bit < FRAMES_PER_WORD)
+        {
+            // What's left of the word, as set bits where the run would
+            // change (starts, or ends)
+            auto changes = (in_run ? ~word : word) >> bit;
+            if (changes == 0) break;
+
+            bit += lowestSetBit_(changes);
+            auto frame = (i * FRAMES_PER_WORD) + bit;
+
+            if (in_run) add_run(run_start, frame);
+            else run_start = frame;
+
+            in_run = !in_run;
+        }
+    }
+
+    // (Bits past framesCount_ are clear, so only a run reaching the very end
+    // of the last word is still open)
+    if (in_run) add_run(run_start, framesCount_);
+    if (have_interval) callback(first_frame, end_frame, start_sample, end_sample);
+}
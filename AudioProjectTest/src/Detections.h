@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Which of a file's frames (chunks) had static, as one bit per frame, and the
+// time ranges those frames cover. A float start time per static frame costs
+// 32x the memory on a file that's mostly static, and leaves callers to piece
+// the runs back together themselves
+//
+// Frame i starts at sample (i * hopSize). Bits past framesCount() are always
+// clear, and bits are only ever set, so spans of whole words (multiples of 64
+// frames) can be filled in by different threads at once
+class Detections
+{
+public:
+    static constexpr std::size_t FRAMES_PER_WORD = 64;
+
+    // Overlapping (or touching) static frames, merged. Covers
+    // [startSeconds, endSeconds), where the end is the end of the last
+    // frame, padding and all (so a zero-padded remainder counts in full)
+    struct Interval
+    {
+        std::size_t firstFrame = 0;
+        std::size_t endFrame = 0; // One past the last static frame
+        float startSeconds = 0.0f;
+        float endSeconds = 0.0f;
+    };
+
+    Detections() = default;
+    Detections(std::size_t hopSize, std::size_t fftSize, float samplingRate);
+
+    // Room for framesCount frames, all clear
+    void reset(std::size_t framesCount);
+
+    // Grows (so allocates) if frame is past the end, which only a file that
+    // grew while it was read should ever need
+    void set(std::size_t frame)
+    {
+        if (frame >= framesCount_) grow_(frame + 1);
+        words_[frame / FRAMES_PER_WORD] |= std::uint64_t(1) << (frame % FRAMES_PER_WORD);
+    }
+
+    bool test(std::size_t frame) const noexcept
+    {
+        return frame < framesCount_
+            && (words_[frame / FRAMES_PER_WORD] >> (frame % FRAMES_PER_WORD)) & 1;
+    }
+
+    std::size_t framesCount() const noexcept { return framesCount_; }
+    const std::vector<std::uint64_t>& words() const noexcept { return words_; }
+
+    // Number of static frames
+    std::size_t count() const noexcept;
+
+    std::vector<Interval> intervals() const;
+
+    // Seconds covered by static frames (overlaps counted once), and the
+    // longest interval. Neither allocates
+    double staticSeconds() const noexcept;
+    double longestIntervalSeconds() const noexcept;
+
+    // The old view: each static frame's start time, in order
+    std::vector<float> startTimes() const;
+
+    float frameStartSeconds(std::size_t frame) const noexcept
+    {
+        return static_cast<float>(frame * hopSize_) / samplingRate_;
+    }
+
+private:
+    std::size_t hopSize_ = 1;
+    std::size_t fftSize_ = 1;
+    float samplingRate_ = 1.0f;
+    std::size_t framesCount_ = 0;
+    std::vector<std::uint64_t> words_{};
+
+    void grow_(std::size_t framesCount);
+
+    template <typename Callback>
+    void forEachInterval_(Callback callback) const;
+
+}; // class Detections
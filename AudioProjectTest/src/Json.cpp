@@ -0,0 +1,40 @@
+#include "Json.h"
+
+#include <cstdio>
+#include <string>
+
+namespace Json
+{
+    void appendQuoted(std::string& out, const std::string& string)
+    {
+        out += '"';
+
+        for (auto c : string)
+        {
+            switch (c)
+            {
+            case '"':   out += "\\\""; break;
+            case '\\':  out += "\\\\"; break;
+            case '\n':  out += "\\n"; break;
+            case '\r':  out += "\\r"; break;
+            case '\t':  out += "\\t"; break;
+
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escaped[8]{};
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                    out += escaped;
+                }
+                else
+                {
+                    out += c;
+                }
+                break;
+            }
+        }
+
+        out += '"';
+    }
+
+} // namespace Json
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+// The bits of JSON writing shared by the results writers and the stats report
+namespace Json
+{
+    // string, quoted and escaped, onto the end of out
+    void appendQuoted(std::string& out, const std::string& string);
+
+    inline std::string quoted(const std::string& string)
+    {
+        std::string out{};
+        appendQuoted(out, string);
+        return out;
+    }
+
+} // namespace Json
@@ -1,25 +1,43 @@
+#include "AllocationCounter.h"
 #include "AudioAnalyzer.h"
+#include "MultiAnalyzer.h"
+#include "Results.h"
+#include "Samples.h"
+#include "Simd.h"
+#include "Spectrogram.h"
+#include "Stats.h"
 #include "Windowing.h"
+#include "Wisdom.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdio>
 #include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <ios>
 #include <iostream>
+#include <istream>
 #include <map>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <system_error>
 #include <vector>
 
+#if defined(_WIN32)
+
+#include <fcntl.h>
+#include <io.h>
+
+#endif
+
 // todo - more robust static detection!
-// todo - an AudioAnalyzer::Config struct to pass instead of multiple args
 // todo - AA should probably know/control its flags, but not parsing (and Main
 // shouldn't know about Windowing)
-// todo - parallel chunk processing
-// todo - error code for analysis struct, present if processing fails, keeping
-// us from throwing or whatever else
 // todo - probably change the use_logging macro/flag to verbose, and make
 // run-time not compile-time
-// todo - add compiler flags to solution file for windows:
-// #define USE_AVX2
 
 // Test args: "--wisdom=C:/Dev/fftwf_wisdom.dat" "C:/Dev/sample-audio-file-human-then-static.raw"
 
@@ -31,10 +49,109 @@ static void parseArgs
     std::vector<std::filesystem::path>& paths
 );
 
-static std::size_t fftSizeFlagValue(const std::map<std::string, std::string>& flags);
-static Windowing::Window windowTypeFlagValue(const std::map<std::string, std::string>& flags);
-static float overlapFlagValue(const std::map<std::string, std::string>& flags);
+static std::vector<std::string> splitList(const std::string& list);
+static std::vector<std::size_t> fftSizeFlagValue(const std::map<std::string, std::string>& flags);
+static std::vector<Windowing::Window> windowTypeFlagValue(const std::map<std::string, std::string>& flags);
+static std::vector<float> overlapFlagValue(const std::map<std::string, std::string>& flags);
 static std::filesystem::path wisdomFlagValue(const std::map<std::string, std::string>& flags);
+static std::size_t threadsFlagValue(const std::map<std::string, std::string>& flags);
+static bool splitFilesFlagValue(const std::map<std::string, std::string>& flags);
+static bool noMmapFlagValue(const std::map<std::string, std::string>& flags);
+static std::size_t batchFlagValue(const std::map<std::string, std::string>& flags);
+static Simd::Level simdFlagValue(const std::map<std::string, std::string>& flags);
+static Wisdom::Planner plannerFlagValue(const std::map<std::string, std::string>& flags);
+static std::vector<std::size_t> sizesFlagValue(const std::map<std::string, std::string>& flags);
+static bool stdinFlagValue(const std::map<std::string, std::string>& flags);
+static std::filesystem::path fifoFlagValue(const std::map<std::string, std::string>& flags);
+static bool noEnergyGateFlagValue(const std::map<std::string, std::string>& flags);
+static std::size_t prefetchFlagValue(const std::map<std::string, std::string>& flags);
+static std::filesystem::path fromListFlagValue(const std::map<std::string, std::string>& flags);
+static bool statsFlagValue(const std::map<std::string, std::string>& flags, std::filesystem::path& path);
+static bool perfCountersFlagValue(const std::map<std::string, std::string>& flags);
+static bool startTimesFlagValue(const std::map<std::string, std::string>& flags);
+static Results::Format formatFlagValue(const std::map<std::string, std::string>& flags);
+static std::filesystem::path spectrogramFlagValue(const std::map<std::string, std::string>& flags);
+static Spectrogram::Format spectrogramFormatFlagValue(const std::map<std::string, std::string>& flags);
+static Samples::Format sampleFormatFlagValue(const std::map<std::string, std::string>& flags);
+
+static void spectrogramBinsFlagValue
+(
+    const std::map<std::string, std::string>& flags,
+    std::size_t& firstBin,
+    std::size_t& endBin
+);
+
+static void prepareSpectrogramPath(const std::filesystem::path& path, std::size_t filesCount);
+
+static std::vector<std::filesystem::path> inputFiles
+(
+    const std::vector<std::filesystem::path>& paths,
+    const std::filesystem::path& list
+);
+
+static void addPath(const std::filesystem::path& path, std::vector<std::filesystem::path>& files);
+static void addDirectory(const std::filesystem::path& directory, std::vector<std::filesystem::path>& files);
+static void addList(std::istream& list, std::vector<std::filesystem::path>& files);
+
+// Prints each file's analysis as soon as it (and every file before it) is
+// done, so output starts right away but stays in input order. With a writer,
+// analyses go to it instead (which buffers them). With a report, it also
+// times the printing and adds each file to the report, in order
+class OrderedPrinter : public AudioAnalyzer::Sink
+{
+public:
+    explicit OrderedPrinter(Stats::Report* report = nullptr, Results::Writer* writer = nullptr)
+        : report_(report)
+        , writer_(writer)
+    {
+    }
+
+    void onFileDone(std::size_t fileIndex, AudioAnalyzer::Analysis&& analysis) override;
+
+    std::size_t chunksCount() const noexcept { return chunksCount_; }
+    std::size_t skippedChunksCount() const noexcept { return skippedChunksCount_; }
+    std::size_t failedCount() const noexcept { return failedCount_; }
+
+private:
+    std::size_t next_ = 0;
+    std::size_t chunksCount_ = 0;
+    std::size_t skippedChunksCount_ = 0;
+    std::size_t failedCount_ = 0;
+    Stats::Report* report_;
+    Results::Writer* writer_;
+
+    // Files that finished before some earlier file did
+    std::map<std::size_t, AudioAnalyzer::Analysis> early_{};
+
+    void print_(AudioAnalyzer::Analysis& analysis);
+};
+
+// Prints each static chunk's start time on its own line as soon as it's
+// found (flushing, so whatever reads our output sees it right away), then a
+// summary on stderr once the input ends
+class LivePrinter : public AudioAnalyzer::Sink
+{
+public:
+    void onStaticChunk(std::size_t fileIndex, float startTimeSeconds) override;
+    void onFileDone(std::size_t fileIndex, AudioAnalyzer::Analysis&& analysis) override;
+};
+
+static void prewarmWisdom
+(
+    AudioAnalyzer::Config config,
+    const std::vector<std::size_t>& fftSizes
+);
+
+static void reportAllocations
+(
+    std::size_t allocations,
+    std::size_t filesCount,
+    std::size_t chunksCount
+);
+
+static void reportSkipped(std::size_t skippedChunksCount, std::size_t chunksCount);
+static void reportFailed(std::size_t failedCount, std::size_t filesCount);
+static void writeStats(const Stats::Report& report, const std::filesystem::path& path);
 
 int main(int argc, char* argv[])
 {
@@ -51,18 +168,164 @@ int main(int argc, char* argv[])
 
     try
     {
-        AudioAnalyzer analyzer
-        (
-            fftSizeFlagValue(flags),
-            windowTypeFlagValue(flags),
-            overlapFlagValue(flags),
-            wisdomFlagValue(flags)
-        );
-
-        auto analyses = analyzer.process(audio_file_paths);
-
-        for (auto& analysis : analyses)
-            std::cout << analysis << std::endl;
+        auto fft_sizes = fftSizeFlagValue(flags);
+        auto window_types = windowTypeFlagValue(flags);
+        auto overlaps = overlapFlagValue(flags);
+
+        AudioAnalyzer::Config config{};
+        config.fftSize = fft_sizes.front();
+        config.windowType = window_types.front();
+        config.overlap = overlaps.front();
+        config.wisdomPath = wisdomFlagValue(flags);
+        config.threads = threadsFlagValue(flags);
+        config.splitFiles = splitFilesFlagValue(flags);
+        config.memoryMap = !noMmapFlagValue(flags);
+        config.batchSize = batchFlagValue(flags);
+        config.simd = simdFlagValue(flags);
+        config.planner = plannerFlagValue(flags);
+        config.energyGate = !noEnergyGateFlagValue(flags);
+        config.prefetch = prefetchFlagValue(flags);
+
+        std::filesystem::path stats_path{};
+        config.stats = statsFlagValue(flags, stats_path);
+
+        // (Counters go in the stats report, so they turn it on)
+        config.perfCounters = perfCountersFlagValue(flags);
+        config.stats = config.stats || config.perfCounters;
+        config.startTimes = startTimesFlagValue(flags);
+        config.spectrogramPath = spectrogramFlagValue(flags);
+        config.spectrogramFormat = spectrogramFormatFlagValue(flags);
+        spectrogramBinsFlagValue(flags, config.spectrogramFirstBin, config.spectrogramEndBin);
+        config.sampleFormat = sampleFormatFlagValue(flags);
+
+        // `AudioProjectTest wisdom --wisdom=<path> --sizes=...` plans ahead
+        // of time instead of analyzing
+        if (argc > 1 && std::string(argv[1]) == "wisdom")
+        {
+            prewarmWisdom(config, sizesFlagValue(flags));
+            return 0;
+        }
+
+        // Anything but text is written through a Results::Writer. (Live
+        // input always prints plain start times)
+        auto format = formatFlagValue(flags);
+        auto live = stdinFlagValue(flags) || !fifoFlagValue(flags).empty();
+        std::unique_ptr<Results::Writer> writer{};
+
+        if (format != Results::Text && !live)
+        {
+#if defined(_WIN32)
+            if (format == Results::Bin) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            writer = std::make_unique<Results::Writer>(format, stdout, config.startTimes);
+        }
+
+        auto sweep = fft_sizes.size() * window_types.size() * overlaps.size() > 1;
+
+        // (One spectrogram per input file, so one configuration)
+        if (!config.spectrogramPath.empty() && (live || sweep))
+            throw std::invalid_argument("--spectrogram takes files and a single configuration.");
+
+        // Lists for any of --fft-size, --window or --overlap mean every
+        // combination of them, over each file in one pass
+        if (sweep)
+        {
+            if (live)
+                throw std::invalid_argument("Live input takes a single configuration.");
+
+            std::vector<AudioAnalyzer::Config> configs{};
+
+            for (auto fft_size : fft_sizes)
+            {
+                for (auto window_type : window_types)
+                {
+                    for (auto overlap : overlaps)
+                    {
+                        config.fftSize = fft_size;
+                        config.windowType = window_type;
+                        config.overlap = overlap;
+                        configs.push_back(config);
+                    }
+                }
+            }
+
+            MultiAnalyzer analyzer(configs);
+            std::cerr << "SIMD: " << Simd::toString(analyzer.simd()) << std::endl;
+
+            auto in_files = inputFiles(audio_file_paths, fromListFlagValue(flags));
+            auto allocations = AllocationCounter::total();
+            Stats::Report report{ Simd::toString(analyzer.simd()), analyzer.threads(), analyzer.planSeconds(), analyzer.wisdomLoadSeconds() };
+            report.perf = config.perfCounters;
+            OrderedPrinter printer(config.stats ? &report : nullptr, writer.get());
+
+            auto start = Stats::Clock::now();
+            analyzer.process(in_files, printer);
+            if (writer) writer->flush();
+            report.wallSeconds = Stats::secondsSince(start);
+
+            if (config.energyGate)
+                reportSkipped(printer.skippedChunksCount(), printer.chunksCount());
+
+            // (Every configuration reports a bad file)
+            reportFailed(printer.failedCount() / configs.size(), in_files.size());
+            if (config.stats) writeStats(report, stats_path);
+
+            if (AllocationCounter::enabled())
+                reportAllocations(AllocationCounter::total() - allocations, in_files.size() * configs.size(), printer.chunksCount());
+
+            return 0;
+        }
+
+        AudioAnalyzer analyzer(config);
+        std::cerr << "SIMD: " << Simd::toString(analyzer.simd()) << std::endl;
+
+        // Live input replaces any files
+        if (stdinFlagValue(flags))
+        {
+#if defined(_WIN32)
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif
+            LivePrinter printer{};
+            analyzer.processStream(std::cin, "stdin", printer);
+            return 0;
+        }
+
+        if (auto fifo = fifoFlagValue(flags); !fifo.empty())
+        {
+            // (Blocks until something opens the other end)
+            std::ifstream raw_audio(fifo, std::ios::binary);
+
+            if (!raw_audio)
+                throw std::runtime_error("Unable to open \"" + fifo.string() + "\"");
+
+            LivePrinter printer{};
+            analyzer.processStream(raw_audio, fifo, printer);
+            return 0;
+        }
+
+        auto in_files = inputFiles(audio_file_paths, fromListFlagValue(flags));
+
+        if (!config.spectrogramPath.empty())
+            prepareSpectrogramPath(config.spectrogramPath, in_files.size());
+
+        auto allocations = AllocationCounter::total();
+        Stats::Report report{ Simd::toString(analyzer.simd()), analyzer.threads(), analyzer.planSeconds(), analyzer.wisdomLoadSeconds() };
+        report.perf = config.perfCounters;
+        OrderedPrinter printer(config.stats ? &report : nullptr, writer.get());
+
+        auto start = Stats::Clock::now();
+        analyzer.process(in_files, printer);
+        if (writer) writer->flush();
+        report.wallSeconds = Stats::secondsSince(start);
+
+        if (config.energyGate)
+            reportSkipped(printer.skippedChunksCount(), printer.chunksCount());
+
+        reportFailed(printer.failedCount(), in_files.size());
+        if (config.stats) writeStats(report, stats_path);
+
+        if (AllocationCounter::enabled())
+            reportAllocations(AllocationCounter::total() - allocations, in_files.size(), printer.chunksCount());
     }
     catch (const std::exception& ex)
     {
@@ -108,34 +371,61 @@ void parseArgs
     }
 }
 
-std::size_t fftSizeFlagValue(const std::map<std::string, std::string>& flags)
+// Comma-separated values (empty ones skipped)
+std::vector<std::string> splitList(const std::string& list)
+{
+    std::vector<std::string> values{};
+    std::istringstream iss(list);
+    std::string value{};
+
+    while (std::getline(iss, value, ','))
+        if (!value.empty()) values.push_back(value);
+
+    if (values.empty())
+        throw std::invalid_argument("Empty list: \"" + list + "\"");
+
+    return values;
+}
+
+// --fft-size, --window and --overlap each take one value or a list
+
+std::vector<std::size_t> fftSizeFlagValue(const std::map<std::string, std::string>& flags)
 {
     auto it = flags.find("fft-size");
+    if (it == flags.end()) return { AudioAnalyzer::DEFAULT_FFT_SIZE };
 
-    if (it != flags.end())
-        return std::stoull(it->second);
+    std::vector<std::size_t> fft_sizes{};
 
-    return AudioAnalyzer::DEFAULT_FFT_SIZE;
+    for (auto& value : splitList(it->second))
+        fft_sizes.push_back(std::stoull(value));
+
+    return fft_sizes;
 }
 
-Windowing::Window windowTypeFlagValue(const std::map<std::string, std::string>& flags)
+std::vector<Windowing::Window> windowTypeFlagValue(const std::map<std::string, std::string>& flags)
 {
     auto it = flags.find("window");
+    if (it == flags.end()) return { AudioAnalyzer::DEFAULT_WINDOW };
 
-    if (it != flags.end())
-        return Windowing::fromString(it->second);
+    std::vector<Windowing::Window> window_types{};
+
+    for (auto& value : splitList(it->second))
+        window_types.push_back(Windowing::fromString(value));
 
-    return AudioAnalyzer::DEFAULT_WINDOW;
+    return window_types;
 }
 
-float overlapFlagValue(const std::map<std::string, std::string>& flags)
+std::vector<float> overlapFlagValue(const std::map<std::string, std::string>& flags)
 {
     auto it = flags.find("overlap");
+    if (it == flags.end()) return { AudioAnalyzer::DEFAULT_OVERLAP };
 
-    if (it != flags.end())
-        return std::stof(it->second);
+    std::vector<float> overlaps{};
+
+    for (auto& value : splitList(it->second))
+        overlaps.push_back(std::stof(value));
 
-    return AudioAnalyzer::DEFAULT_OVERLAP;
+    return overlaps;
 }
 
 std::filesystem::path wisdomFlagValue(const std::map<std::string, std::string>& flags)
@@ -147,3 +437,437 @@ std::filesystem::path wisdomFlagValue(const std::map<std::string, std::string>&
 
     return {};
 }
+
+std::size_t threadsFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("threads");
+
+    if (it != flags.end())
+        return std::stoull(it->second);
+
+    return AudioAnalyzer::DEFAULT_THREADS;
+}
+
+bool splitFilesFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("split-files");
+    return it != flags.end() && it->second != "false";
+}
+
+bool noMmapFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("no-mmap");
+    return it != flags.end() && it->second != "false";
+}
+
+std::size_t batchFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("batch");
+
+    if (it != flags.end())
+        return std::stoull(it->second);
+
+    return AudioAnalyzer::DEFAULT_BATCH_SIZE;
+}
+
+Simd::Level simdFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("simd");
+
+    if (it != flags.end())
+        return Simd::fromString(it->second);
+
+    return Simd::Auto;
+}
+
+Wisdom::Planner plannerFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("planner");
+
+    if (it != flags.end())
+        return Wisdom::fromString(it->second);
+
+    return Wisdom::Auto;
+}
+
+// Comma-separated, falling back to --fft-size
+std::vector<std::size_t> sizesFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("sizes");
+    if (it == flags.end()) return fftSizeFlagValue(flags);
+
+    std::vector<std::size_t> sizes{};
+
+    for (auto& value : splitList(it->second))
+        sizes.push_back(std::stoull(value));
+
+    return sizes;
+}
+
+bool stdinFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("stdin");
+    return it != flags.end() && it->second != "false";
+}
+
+std::filesystem::path fifoFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("fifo");
+
+    if (it != flags.end())
+        return it->second;
+
+    return {};
+}
+
+bool noEnergyGateFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("no-energy-gate");
+    return it != flags.end() && it->second != "false";
+}
+
+std::size_t prefetchFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("prefetch");
+
+    if (it != flags.end())
+        return std::stoull(it->second);
+
+    return AudioAnalyzer::DEFAULT_PREFETCH;
+}
+
+std::filesystem::path fromListFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("from-list");
+
+    if (it != flags.end())
+        return it->second;
+
+    return {};
+}
+
+// `--stats` alone writes the report to stderr; `--stats=<path>` writes it to
+// a file
+bool statsFlagValue(const std::map<std::string, std::string>& flags, std::filesystem::path& path)
+{
+    auto it = flags.find("stats");
+    if (it == flags.end() || it->second == "false") return false;
+
+    if (it->second != "true") path = it->second;
+    return true;
+}
+
+bool perfCountersFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("perf-counters");
+    return it != flags.end() && it->second != "false";
+}
+
+bool startTimesFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("start-times");
+    return it != flags.end() && it->second != "false";
+}
+
+Results::Format formatFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("format");
+
+    if (it != flags.end())
+        return Results::fromString(it->second);
+
+    return Results::Text;
+}
+
+std::filesystem::path spectrogramFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("spectrogram");
+
+    if (it != flags.end())
+        return it->second;
+
+    return {};
+}
+
+Spectrogram::Format spectrogramFormatFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("spectrogram-format");
+
+    if (it != flags.end())
+        return Spectrogram::fromString(it->second);
+
+    return Spectrogram::Float32;
+}
+
+// (Not --format, which is how results are written)
+Samples::Format sampleFormatFlagValue(const std::map<std::string, std::string>& flags)
+{
+    auto it = flags.find("sample-format");
+
+    if (it != flags.end())
+        return Samples::fromString(it->second);
+
+    return Samples::Int16;
+}
+
+// "first-end", a half-open range of bins. Either side can be left out
+void spectrogramBinsFlagValue
+(
+    const std::map<std::string, std::string>& flags,
+    std::size_t& firstBin,
+    std::size_t& endBin
+)
+{
+    auto it = flags.find("spectrogram-bins");
+    if (it == flags.end()) return;
+
+    auto& range = it->second;
+    auto dash_pos = range.find('-');
+
+    if (dash_pos == std::string::npos)
+        throw std::invalid_argument("--spectrogram-bins takes a range, like 10-200.");
+
+    auto first = range.substr(0, dash_pos);
+    auto end = range.substr(dash_pos + 1);
+
+    if (!first.empty()) firstBin = std::stoull(first);
+    if (!end.empty()) endBin = std::stoull(end);
+}
+
+// A .npy path is the one output file, so only for one input. Anything else
+// is a directory of them, made if it has to be
+void prepareSpectrogramPath(const std::filesystem::path& path, std::size_t filesCount)
+{
+    if (path.extension() == ".npy")
+    {
+        if (filesCount > 1)
+            throw std::invalid_argument("A single --spectrogram file takes a single input file; pass a directory instead.");
+
+        return;
+    }
+
+    std::filesystem::create_directories(path);
+}
+
+// The files to analyze: paths given as arguments, then any listed in the
+// --from-list file ("-" for stdin). Directories in either are walked
+// recursively.
+// Reading them from a list or a directory instead of the command line avoids
+// the shell's argument length limit. Paths that don't exist are kept, so
+// they're reported (in order) with the rest
+std::vector<std::filesystem::path> inputFiles
+(
+    const std::vector<std::filesystem::path>& paths,
+    const std::filesystem::path& list
+)
+{
+    std::vector<std::filesystem::path> files{};
+
+    for (auto& path : paths)
+        addPath(path, files);
+
+    if (list.empty()) return files;
+
+    if (list == "-")
+    {
+        addList(std::cin, files);
+        return files;
+    }
+
+    std::ifstream list_file(list);
+
+    if (!list_file)
+        throw std::runtime_error("Unable to open \"" + list.string() + "\"");
+
+    addList(list_file, files);
+    return files;
+}
+
+void addPath(const std::filesystem::path& path, std::vector<std::filesystem::path>& files)
+{
+    std::error_code ec{};
+
+    if (std::filesystem::is_directory(path, ec))
+        addDirectory(path, files);
+    else
+        files.push_back(path);
+}
+
+// Every regular file under directory, sorted, since directory order is
+// whatever the filesystem feels like
+void addDirectory(const std::filesystem::path& directory, std::vector<std::filesystem::path>& files)
+{
+    auto first = files.size();
+    std::error_code ec{};
+
+    std::filesystem::recursive_directory_iterator it
+    (
+        directory,
+        std::filesystem::directory_options::skip_permission_denied,
+        ec
+    );
+
+    for (; !ec && it != std::filesystem::recursive_directory_iterator{}; it.increment(ec))
+    {
+        std::error_code type_ec{};
+        if (it->is_regular_file(type_ec)) files.push_back(it->path());
+    }
+
+    if (ec)
+        throw std::runtime_error("Unable to read \"" + directory.string() + "\": " + ec.message());
+
+    std::sort(files.begin() + first, files.end());
+}
+
+// One path per line. Blank lines are skipped
+void addList(std::istream& list, std::vector<std::filesystem::path>& files)
+{
+    std::string line{};
+
+    while (std::getline(list, line))
+    {
+        // (Lists written on Windows)
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) addPath(line, files);
+    }
+}
+
+void OrderedPrinter::onFileDone(std::size_t fileIndex, AudioAnalyzer::Analysis&& analysis)
+{
+    chunksCount_ += analysis.chunksCount;
+    skippedChunksCount_ += analysis.skippedChunksCount;
+    if (!analysis.error.empty()) ++failedCount_;
+
+    if (fileIndex != next_)
+    {
+        early_.emplace(fileIndex, std::move(analysis));
+        return;
+    }
+
+    print_(analysis);
+    ++next_;
+
+    // Anything that was only waiting on this one
+    for (auto it = early_.begin(); it != early_.end() && it->first == next_; it = early_.erase(it))
+    {
+        print_(it->second);
+        ++next_;
+    }
+}
+
+void OrderedPrinter::print_(AudioAnalyzer::Analysis& analysis)
+{
+    auto start = report_ ? Stats::Clock::now() : Stats::Clock::time_point{};
+
+    if (writer_)
+        writer_->write(analysis);
+    else
+        std::cout << analysis << std::endl;
+
+    if (!report_) return;
+
+    analysis.stats.seconds[Stats::Output] += Stats::secondsSince(start);
+
+    report_->files.push_back
+    (
+        {
+            analysis.file,
+            analysis.error,
+            analysis.chunksCount,
+            analysis.skippedChunksCount,
+            analysis.stats
+        }
+    );
+}
+
+void LivePrinter::onStaticChunk(std::size_t, float startTimeSeconds)
+{
+    std::cout << std::fixed << std::setprecision(2) << startTimeSeconds << std::endl;
+}
+
+void LivePrinter::onFileDone(std::size_t, AudioAnalyzer::Analysis&& analysis)
+{
+    std::cerr << "Analyzed " << analysis.chunksCount << " chunks from " << analysis.file.string()
+        << " (" << analysis.skippedChunksCount << " skipped by the energy gate)" << std::endl;
+}
+
+// An analyzer plans (and saves any new wisdom) as it's constructed, so making
+// one per size is all it takes. Plans depend on the FFT size and --batch, not
+// on the window, overlap or thread count, so later runs with the same size,
+// batch and planner (or a lesser planner) never plan at startup
+void prewarmWisdom
+(
+    AudioAnalyzer::Config config,
+    const std::vector<std::size_t>& fftSizes
+)
+{
+    if (config.wisdomPath.empty())
+        throw std::invalid_argument("The wisdom command needs --wisdom=<path>.");
+
+    config.threads = 1;
+
+    for (auto fft_size : fftSizes)
+    {
+        config.fftSize = fft_size;
+        AudioAnalyzer analyzer(config);
+
+        std::cout << "Planned FFT size " << fft_size
+            << " (batch " << config.batchSize << ", "
+            << Wisdom::toString(config.planner) << ")" << std::endl;
+    }
+}
+
+// Only for builds with COUNT_ALLOCATIONS. Goes to stderr so stdout stays just
+// the analyses
+void reportAllocations
+(
+    std::size_t allocations,
+    std::size_t filesCount,
+    std::size_t chunksCount
+)
+{
+    auto per = [allocations](std::size_t count)
+        {
+            return count ? static_cast<double>(allocations) / count : 0.0;
+        };
+
+    std::cerr << "Allocations: " << allocations
+        << " (" << per(filesCount) << " per file, "
+        << per(chunksCount) << " per chunk)" << std::endl;
+}
+
+// Also stderr. How many chunks were too quiet to need an FFT
+void reportSkipped(std::size_t skippedChunksCount, std::size_t chunksCount)
+{
+    auto percent = chunksCount ? (100.0 * skippedChunksCount) / chunksCount : 0.0;
+
+    std::cerr << "Energy gate: skipped " << skippedChunksCount << " of " << chunksCount
+        << " chunks (" << std::fixed << std::setprecision(1) << percent << "%)" << std::endl;
+}
+
+// Also stderr. How many files couldn't be analyzed (each one's Analysis says
+// why)
+void reportFailed(std::size_t failedCount, std::size_t filesCount)
+{
+    if (failedCount == 0) return;
+
+    std::cerr << "Failed: " << failedCount << " of " << filesCount
+        << " files couldn't be analyzed" << std::endl;
+}
+
+// JSON (see Stats::writeJson), on stderr unless there's a path
+void writeStats(const Stats::Report& report, const std::filesystem::path& path)
+{
+    if (path.empty())
+    {
+        Stats::writeJson(std::cerr, report);
+        return;
+    }
+
+    std::ofstream file(path);
+
+    if (!file)
+        throw std::runtime_error("Unable to open \"" + path.string() + "\"");
+
+    Stats::writeJson(file, report);
+}
@@ -0,0 +1,102 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HAVE_MMAP
+
+#endif
+
+#if defined(HAVE_MMAP)
+
+MappedFile::MappedFile
+(
+    const std::filesystem::path& path,
+    std::uintmax_t offset,
+    std::uintmax_t length
+)
+{
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        return;
+    }
+
+    auto file_size = static_cast<std::uintmax_t>(st.st_size);
+    offset = std::min(offset, file_size);
+    length = std::min(length, file_size - offset);
+
+    // mmap can't map nothing, but an empty range is still a valid (empty) view
+    if (length == 0)
+    {
+        ::close(fd);
+        isOpen_ = true;
+        return;
+    }
+
+    // Offsets passed to mmap have to be page-aligned
+    auto page_size = static_cast<std::uintmax_t>(::sysconf(_SC_PAGESIZE));
+    auto aligned_offset = offset - (offset % page_size);
+    auto lead = static_cast<std::size_t>(offset - aligned_offset);
+    auto mapping_size = lead + static_cast<std::size_t>(length);
+
+    auto mapping = ::mmap
+    (
+        nullptr,
+        mapping_size,
+        PROT_READ,
+        MAP_PRIVATE,
+        fd,
+        static_cast<off_t>(aligned_offset)
+    );
+
+    // The mapping holds its own reference to the file
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) return;
+
+    // Hints only; failure here doesn't matter
+    ::madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+
+    if (mapping_size <= WILL_NEED_LIMIT_)
+        ::madvise(mapping, mapping_size, MADV_WILLNEED);
+
+    isOpen_ = true;
+    mapping_ = mapping;
+    mappingSize_ = mapping_size;
+    data_ = static_cast<const unsigned char*>(mapping) + lead;
+    size_ = static_cast<std::size_t>(length);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapping_) ::munmap(mapping_, mappingSize_);
+}
+
+#else // !defined(HAVE_MMAP)
+
+// No mapping on this platform (yet); callers will use the stream reader
+MappedFile::MappedFile(const std::filesystem::path&, std::uintmax_t, std::uintmax_t)
+{
+}
+
+MappedFile::~MappedFile()
+{
+}
+
+#endif // defined(HAVE_MMAP)
+
+#undef HAVE_MMAP
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Read-only memory map of (part of) a file. Lets the analyzer convert samples
+// straight out of the page cache instead of copying them through an ifstream
+// first. Mapping can fail (unsupported platform, special files, address space
+// limits), so callers check isOpen() and fall back to streaming.
+class MappedFile
+{
+public:
+    static constexpr auto WHOLE_FILE = static_cast<std::uintmax_t>(-1);
+
+    explicit MappedFile
+    (
+        const std::filesystem::path& path,
+        std::uintmax_t offset = 0,
+        std::uintmax_t length = WHOLE_FILE
+    );
+
+    virtual ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const noexcept { return isOpen_; }
+
+    // Points at the requested offset (not necessarily the start of the
+    // mapping, which has to be page-aligned)
+    const unsigned char* data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+
+private:
+    bool isOpen_ = false;
+    void* mapping_ = nullptr;
+    std::size_t mappingSize_ = 0;
+    const unsigned char* data_ = nullptr;
+    std::size_t size_ = 0;
+
+    // Anything smaller than this also gets MADV_WILLNEED, so the kernel starts
+    // reading all of it right away. Bigger ranges just rely on MADV_SEQUENTIAL
+    // readahead
+    static constexpr std::size_t WILL_NEED_LIMIT_ = 64 * 1024 * 1024;
+
+}; // class MappedFile
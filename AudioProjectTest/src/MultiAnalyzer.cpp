@@ -0,0 +1,449 @@
+#include "AudioAnalyzer.h"
+#include "MappedFile.h"
+#include "MultiAnalyzer.h"
+#include "Prefetcher.h"
+#include "Samples.h"
+#include "Stats.h"
+#include "Wisdom.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    // Hands one configuration's results on to the real sink, under the real
+    // sink's index, one call at a time (analyzers in different rows run
+    // concurrently). read (unless null) is added to the Analysis's stats
+    class Forward final : public AudioAnalyzer::Sink
+    {
+    public:
+        Forward
+        (
+            AudioAnalyzer::Sink& sink,
+            std::mutex& mutex,
+            std::size_t config,
+            std::size_t configsCount,
+            const Stats::Counters* read = nullptr
+        )
+            : sink_(sink)
+            , mutex_(mutex)
+            , config_(config)
+            , configsCount_(configsCount)
+            , read_(read)
+        {
+        }
+
+        void onStaticChunk(std::size_t fileIndex, float startTimeSeconds) override
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sink_.onStaticChunk(index_(fileIndex), startTimeSeconds);
+        }
+
+        void onFileDone(std::size_t fileIndex, AudioAnalyzer::Analysis&& analysis) override
+        {
+            if (read_) analysis.stats += *read_;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            sink_.onFileDone(index_(fileIndex), std::move(analysis));
+        }
+
+    private:
+        AudioAnalyzer::Sink& sink_;
+        std::mutex& mutex_;
+        std::size_t config_;
+        std::size_t configsCount_;
+        const Stats::Counters* read_;
+
+        std::size_t index_(std::size_t fileIndex) const noexcept
+        {
+            return (fileIndex * configsCount_) + config_;
+        }
+    };
+
+} // namespace
+
+MultiAnalyzer::MultiAnalyzer(const std::vector<AudioAnalyzer::Config>& configs)
+    : configsCount_(configs.size())
+{
+    if (configs.empty())
+    {
+        throw std::invalid_argument("No configurations provided.");
+    }
+
+    auto& first = configs.front();
+    threads_ = first.threads ? first.threads : std::max(1u, std::thread::hardware_concurrency());
+    memoryMap_ = first.memoryMap;
+    prefetch_ = first.prefetch;
+    stats_ = first.stats;
+    sampleFormat_ = first.sampleFormat;
+    bytesPerSample_ = Samples::bytesPerSample(sampleFormat_);
+
+    // Decoded here to Float32's scale ([-1, 1]), which the analyzers' Float32
+    // kernels scale straight back up. (Both by powers of 2, so exact: the
+    // same samples as decoding in each analyzer.) Not worth it for s16le, or
+    // with only one configuration
+    auto decode_once = configs.size() > 1
+        && sampleFormat_ != Samples::Int16
+        && sampleFormat_ != Samples::Float32;
+
+    rows_.resize(threads_);
+
+    for (std::size_t row = 0; row < threads_; ++row)
+    {
+        for (auto config : configs)
+        {
+            config.threads = 1;
+            config.splitFiles = false;
+            config.sampleFormat = decode_once ? Samples::Float32 : sampleFormat_;
+
+            // Only the first row loads (and saves) the wisdom file. The rest
+            // plan with the same effort, which FFTW answers from memory
+            if (row > 0)
+            {
+                config.planner = Wisdom::resolve(config.planner, !config.wisdomPath.empty());
+                config.wisdomPath.clear();
+            }
+
+            rows_[row].emplace_back(std::make_unique<AudioAnalyzer>(config));
+        }
+    }
+
+    auto& analyzer = *rows_.front().front();
+    if (decode_once) decode_ = &analyzer.kernels_->converts[sampleFormat_];
+
+    // Room for a block past the most a block can keep (less than a chunk)
+    std::size_t max_fft_size = 0;
+    for (auto& config_analyzer : rows_.front())
+        max_fft_size = std::max(max_fft_size, config_analyzer->fftSize_);
+
+    auto block_samples = BLOCK_SAMPLES_ + max_fft_size;
+
+    blocks_.resize(threads_);
+    buffers_.resize(threads_);
+    feeds_.resize(threads_);
+
+    for (std::size_t row = 0; row < threads_; ++row)
+    {
+        blocks_[row].resize(block_samples * analyzer.bytesPerSample_);
+        if (decode_) buffers_[row].resize(block_samples * bytesPerSample_);
+        feeds_[row].resize(configsCount_);
+    }
+
+    if (threads_ > 1) pool_ = std::make_unique<WorkStealingPool>(threads_);
+}
+
+MultiAnalyzer::~MultiAnalyzer()
+{
+    // Join the workers before the analyzers they use go away
+    pool_.reset();
+}
+
+double MultiAnalyzer::planSeconds() const noexcept
+{
+    auto seconds = 0.0;
+
+    for (auto& row : rows_)
+        for (auto& analyzer : row)
+            seconds += analyzer->planSeconds();
+
+    return seconds;
+}
+
+double MultiAnalyzer::wisdomLoadSeconds() const noexcept
+{
+    auto seconds = 0.0;
+
+    for (auto& row : rows_)
+        for (auto& analyzer : row)
+            seconds += analyzer->wisdomLoadSeconds();
+
+    return seconds;
+}
+
+void MultiAnalyzer::process(const std::vector<std::filesystem::path>& inFiles, AudioAnalyzer::Sink& sink)
+{
+    if (inFiles.empty())
+    {
+        throw std::invalid_argument("No input files provided.");
+    }
+
+    if (!pool_)
+    {
+        std::vector<std::size_t> order(inFiles.size());
+        std::iota(order.begin(), order.end(), std::size_t(0));
+        Prefetcher prefetcher(inFiles, std::move(order), prefetch_);
+
+        for (std::size_t i = 0; i < inFiles.size(); ++i)
+        {
+            prefetcher.reached(i);
+            processFile_(inFiles[i], i, 0, sink);
+        }
+
+        return;
+    }
+
+    // Biggest files first, for the same reason as AudioAnalyzer::processFiles_
+    std::vector<std::uintmax_t> sizes(inFiles.size(), 0);
+    for (std::size_t i = 0; i < inFiles.size(); ++i)
+    {
+        std::error_code ec{};
+        auto size = std::filesystem::file_size(inFiles[i], ec);
+        if (!ec) sizes[i] = size;
+    }
+
+    std::vector<std::size_t> order(inFiles.size());
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    std::stable_sort
+    (
+        order.begin(),
+        order.end(),
+        [&sizes](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; }
+    );
+
+    Prefetcher prefetcher(inFiles, order, prefetch_);
+
+    for (std::size_t position = 0; position < order.size(); ++position)
+    {
+        pool_->submit
+        (
+            [this, &inFiles, &sink, &prefetcher, i = order[position], position](std::size_t workerIndex)
+            {
+                prefetcher.reached(position);
+                processFile_(inFiles[i], i, workerIndex, sink);
+            }
+        );
+    }
+
+    pool_->wait();
+}
+
+void MultiAnalyzer::processFile_
+(
+    const std::filesystem::path& inFile,
+    std::size_t fileIndex,
+    std::size_t row,
+    AudioAnalyzer::Sink& sink
+)
+{
+    auto& analyzer = *rows_[row].front();
+
+    if (auto error = analyzer.checkFile_(inFile); !error.empty())
+    {
+        fail_(inFile, fileIndex, row, error, sink);
+        return;
+    }
+
+    // The one read (or map) of the file is counted against the first
+    // configuration. (Once per file, so it's timed either way)
+    Stats::Counters read{};
+
+    if (memoryMap_)
+    {
+        auto map_start = Stats::Clock::now();
+        MappedFile mapped(inFile);
+        read.seconds[Stats::Read] = Stats::secondsSince(map_start);
+
+        if (mapped.isOpen())
+        {
+            auto count = mapped.size() / bytesPerSample_;
+            read.bytes = mapped.size();
+            read.samples = count;
+
+            // Already as the analyzers take it, so the mapping is the block
+            if (!decode_)
+                analyze_(mapped.data(), count, inFile, fileIndex, row, stats_ ? &read : nullptr, sink);
+            else
+                stream_(mapped.data(), nullptr, count, inFile, fileIndex, row, read, sink);
+
+            return;
+        }
+    }
+
+    std::ifstream raw_audio(inFile, std::ios::binary);
+    std::error_code ec{};
+    auto file_size = std::filesystem::file_size(inFile, ec);
+
+    if (!raw_audio || ec)
+    {
+        fail_(inFile, fileIndex, row, "Unable to open file.", sink);
+        return;
+    }
+
+    stream_(nullptr, &raw_audio, file_size / bytesPerSample_, inFile, fileIndex, row, read, sink);
+}
+
+// A whole file's samples, already in memory
+void MultiAnalyzer::analyze_
+(
+    const unsigned char* samples,
+    std::size_t count,
+    const std::filesystem::path& inFile,
+    std::size_t fileIndex,
+    std::size_t row,
+    const Stats::Counters* read,
+    AudioAnalyzer::Sink& sink
+)
+{
+    for (std::size_t config = 0; config < configsCount_; ++config)
+    {
+        auto& analyzer = *rows_[row][config];
+        auto& feed = feeds_[row][config];
+        Forward forward(sink, sinkMutex_, config, configsCount_, config == 0 ? read : nullptr);
+
+        analyzer.beginFeed_(feed, inFile, count);
+        analyzer.feed_(feed, samples, 0, count, fileIndex, forward);
+        analyzer.endFeed_(feed, fileIndex, forward);
+    }
+}
+
+// A file a block at a time, through this thread's block: read from rawAudio
+// if it isn't null, otherwise decoded from mapped. Between blocks, only the
+// samples of chunks no configuration has finished yet are kept
+void MultiAnalyzer::stream_
+(
+    const unsigned char* mapped,
+    std::istream* rawAudio,
+    std::size_t totalSamples,
+    const std::filesystem::path& inFile,
+    std::size_t fileIndex,
+    std::size_t row,
+    Stats::Counters& read,
+    AudioAnalyzer::Sink& sink
+)
+{
+    auto& analyzers = rows_[row];
+    auto& feeds = feeds_[row];
+    auto block = blocks_[row].data();
+    auto block_bytes = analyzers.front()->bytesPerSample_;
+    auto block_samples = blocks_[row].size() / block_bytes;
+
+    for (std::size_t config = 0; config < configsCount_; ++config)
+        analyzers[config]->beginFeed_(feeds[config], inFile, totalSamples);
+
+    // The block holds samples [first_sample, end_sample)
+    std::size_t first_sample = 0;
+    std::size_t end_sample = 0;
+
+    while (true)
+    {
+        auto kept = end_sample - first_sample;
+        auto wanted = std::min(block_samples - kept, totalSamples - end_sample);
+        auto loaded = load_(mapped, rawAudio, end_sample, wanted, block + (kept * block_bytes), row, read);
+        end_sample += loaded;
+
+        // (The file shrank since it was sized)
+        if (loaded < wanted)
+        {
+            totalSamples = end_sample;
+
+            for (std::size_t config = 0; config < configsCount_; ++config)
+                analyzers[config]->truncateFeed_(feeds[config], totalSamples);
+        }
+
+        auto needed = end_sample;
+
+        for (std::size_t config = 0; config < configsCount_; ++config)
+        {
+            Forward forward(sink, sinkMutex_, config, configsCount_);
+            auto config_needed = analyzers[config]->feed_(feeds[config], block, first_sample, end_sample, fileIndex, forward);
+            needed = std::min(needed, config_needed);
+        }
+
+        if (end_sample >= totalSamples) break;
+
+        std::memmove(block, block + ((needed - first_sample) * block_bytes), (end_sample - needed) * block_bytes);
+        first_sample = needed;
+    }
+
+    for (std::size_t config = 0; config < configsCount_; ++config)
+    {
+        Forward forward(sink, sinkMutex_, config, configsCount_, (config == 0 && stats_) ? &read : nullptr);
+        analyzers[config]->endFeed_(feeds[config], fileIndex, forward);
+    }
+}
+
+// count samples, from firstSample on, into block as the analyzers take them.
+// Returns how many there were (short only at the end of a stream)
+std::size_t MultiAnalyzer::load_
+(
+    const unsigned char* mapped,
+    std::istream* rawAudio,
+    std::size_t firstSample,
+    std::size_t count,
+    unsigned char* block,
+    std::size_t row,
+    Stats::Counters& read
+)
+{
+    auto stats = stats_ ? &read : nullptr;
+    auto input = rawAudio ? nullptr : (mapped + (firstSample * bytesPerSample_));
+
+    // Nothing to decode means the block takes the input's bytes as they are
+    if (rawAudio)
+    {
+        auto destination = decode_ ? buffers_[row].data() : block;
+
+        {
+            Stats::Timer timer(stats, Stats::Read);
+
+            rawAudio->read
+            (
+                reinterpret_cast<char*>(destination),
+                static_cast<std::streamsize>(count * bytesPerSample_)
+            );
+        }
+
+        // (Dropping a partial sample at the end)
+        auto bytes = static_cast<std::size_t>(rawAudio->gcount());
+        count = bytes / bytesPerSample_;
+        read.bytes += bytes;
+        read.samples += count;
+
+        if (!decode_) return count;
+        input = destination;
+    }
+
+    Stats::Timer timer(stats, Stats::Convert);
+
+    auto decoded = reinterpret_cast<float*>(block);
+    decode_->convert(input, count, decoded);
+
+    constexpr auto TO_FLOAT32 = 1.0f / 32768.0f;
+    for (std::size_t i = 0; i < count; ++i) decoded[i] *= TO_FLOAT32;
+
+    return count;
+}
+
+// A bad file gets an error Analysis from every configuration
+void MultiAnalyzer::fail_
+(
+    const std::filesystem::path& inFile,
+    std::size_t fileIndex,
+    std::size_t row,
+    const std::string& error,
+    AudioAnalyzer::Sink& sink
+)
+{
+    for (std::size_t config = 0; config < configsCount_; ++config)
+    {
+        auto analysis = rows_[row][config]->makeAnalysis_(inFile);
+        analysis.error = error;
+        Forward(sink, sinkMutex_, config, configsCount_).onFileDone(fileIndex, std::move(analysis));
+    }
+}
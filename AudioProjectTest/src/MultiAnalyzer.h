@@ -0,0 +1,141 @@
+#pragma once
+
+#include "AudioAnalyzer.h"
+#include "Samples.h"
+#include "Simd.h"
+#include "Stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class WorkStealingPool;
+
+// Several analyzer configurations (FFT size, window, overlap, ...) over the
+// same files in one pass, for parameter sweeps. Each file is mapped (or read)
+// once, and its samples go to one analyzer per configuration, back to back,
+// while they're still in cache. Files that have to be read, or decoded, go
+// through a fixed-size block per thread, so memory doesn't grow with them.
+// Formats that take real work to decode (anything but s16le and f32le) are
+// decoded once per block, for every configuration.
+//
+// Results go to the sink with fileIndex = (file * configsCount()) + config,
+// so a sink that orders by index gets each file's configurations together,
+// in the order they were given. (Each Analysis also says which FFT size,
+// window and overlap it's for)
+class MultiAnalyzer
+{
+public:
+    // threads, memoryMap and sampleFormat come from the first configuration
+    // (each file is read once, for all of them). splitFiles is ignored
+    // (files are the unit of work here)
+    explicit MultiAnalyzer(const std::vector<AudioAnalyzer::Config>& configs);
+    virtual ~MultiAnalyzer();
+
+    MultiAnalyzer(const MultiAnalyzer&) = delete;
+    MultiAnalyzer& operator=(const MultiAnalyzer&) = delete;
+
+    std::size_t configsCount() const noexcept { return configsCount_; }
+
+    // (The same for every configuration, unless they asked for different
+    // ones)
+    Simd::Level simd() const noexcept { return rows_.front().front()->simd(); }
+
+    std::size_t threads() const noexcept { return threads_; }
+
+    // Summed over every analyzer (see AudioAnalyzer::planSeconds)
+    double planSeconds() const noexcept;
+    double wisdomLoadSeconds() const noexcept;
+
+    void process(const std::vector<std::filesystem::path>& inFiles, AudioAnalyzer::Sink& sink);
+
+private:
+    std::size_t configsCount_;
+    std::size_t threads_;
+    bool memoryMap_;
+    std::size_t prefetch_;
+    bool stats_;
+
+    Samples::Format sampleFormat_;
+    std::size_t bytesPerSample_; // Of the input (the analyzers' can differ)
+
+    // The input's decoder, if it's decoded once here (then every analyzer
+    // takes Float32 instead)
+    const Simd::ConvertKernels* decode_ = nullptr;
+
+    // One analyzer per configuration, per thread (an analyzer's workspace is
+    // only ever used by one thread at a time). The plans are only really
+    // made for the first row; FFTW has them in memory after that
+    std::vector<std::vector<std::unique_ptr<AudioAnalyzer>>> rows_{};
+
+    // Samples per block, past the few chunks' worth kept from the last one
+    static constexpr std::size_t BLOCK_SAMPLES_ = 65536;
+
+    // Per thread: the block, as the analyzers take it, and the input's bytes
+    // it was decoded from (when decoding). Sized once, up front
+    std::vector<std::vector<unsigned char>> blocks_{};
+    std::vector<std::vector<unsigned char>> buffers_{};
+
+    // Per thread, one per configuration
+    std::vector<std::vector<AudioAnalyzer::Feed_>> feeds_{};
+
+    std::unique_ptr<WorkStealingPool> pool_{};
+    std::mutex sinkMutex_{};
+
+    void processFile_
+    (
+        const std::filesystem::path& inFile,
+        std::size_t fileIndex,
+        std::size_t row,
+        AudioAnalyzer::Sink& sink
+    );
+
+    void analyze_
+    (
+        const unsigned char* samples,
+        std::size_t count,
+        const std::filesystem::path& inFile,
+        std::size_t fileIndex,
+        std::size_t row,
+        const Stats::Counters* read,
+        AudioAnalyzer::Sink& sink
+    );
+
+    void stream_
+    (
+        const unsigned char* mapped,
+        std::istream* rawAudio,
+        std::size_t totalSamples,
+        const std::filesystem::path& inFile,
+        std::size_t fileIndex,
+        std::size_t row,
+        Stats::Counters& read,
+        AudioAnalyzer::Sink& sink
+    );
+
+    std::size_t load_
+    (
+        const unsigned char* mapped,
+        std::istream* rawAudio,
+        std::size_t firstSample,
+        std::size_t count,
+        unsigned char* block,
+        std::size_t row,
+        Stats::Counters& read
+    );
+
+    void fail_
+    (
+        const std::filesystem::path& inFile,
+        std::size_t fileIndex,
+        std::size_t row,
+        const std::string& error,
+        AudioAnalyzer::Sink& sink
+    );
+
+}; // class MultiAnalyzer
@@ -0,0 +1,211 @@
+#include "PerfCounters.h"
+
+#include <cstddef>
+#include <string>
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    struct EventConfig
+    {
+        std::uint32_t type;
+        std::uint64_t config;
+    };
+
+    constexpr EventConfig EVENT_CONFIGS[PerfCounters::EVENTS_COUNT] =
+    {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        {
+            PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D
+                | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+        },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+    };
+
+    // One group per thread, so a single read gets every counter, all covering
+    // the same stretch of time. The first counter that opens leads it
+    class Group
+    {
+    public:
+        Group()
+        {
+            for (std::size_t i = 0; i < PerfCounters::EVENTS_COUNT; ++i)
+            {
+                perf_event_attr attr{};
+                attr.size = sizeof(attr);
+                attr.type = EVENT_CONFIGS[i].type;
+                attr.config = EVENT_CONFIGS[i].config;
+                attr.disabled = (leader_ < 0) ? 1 : 0;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP
+                    | PERF_FORMAT_TOTAL_TIME_ENABLED
+                    | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                // This thread, any CPU
+                auto fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+
+                if (fd < 0)
+                {
+                    if (error_ == 0) error_ = errno;
+                    continue;
+                }
+
+                if (leader_ < 0) leader_ = fd;
+                fds_[i] = fd;
+                order_[opened_++] = static_cast<PerfCounters::Event>(i);
+            }
+
+            if (leader_ >= 0)
+            {
+                ::ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ::ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+        }
+
+        ~Group()
+        {
+            for (auto fd : fds_)
+                if (fd >= 0) ::close(fd);
+        }
+
+        Group(const Group&) = delete;
+        Group& operator=(const Group&) = delete;
+
+        bool available() const noexcept { return leader_ >= 0; }
+        bool available(PerfCounters::Event event) const noexcept { return fds_[event] >= 0; }
+        int error() const noexcept { return error_; }
+
+        PerfCounters::Values read() const noexcept
+        {
+            PerfCounters::Values values{};
+            if (leader_ < 0) return values;
+
+            // nr, time_enabled, time_running, then one value per counter
+            std::uint64_t data[3 + PerfCounters::EVENTS_COUNT]{};
+            if (::read(leader_, data, sizeof(data)) <= 0) return values;
+
+            auto count = static_cast<std::size_t>(data[0]);
+            auto enabled = static_cast<double>(data[1]);
+            auto running = static_cast<double>(data[2]);
+
+            // Never scheduled (more counters than the PMU could fit)
+            if (running <= 0.0) return values;
+
+            auto scale = enabled / running;
+
+            for (std::size_t i = 0; i < count && i < opened_; ++i)
+                values.counts[order_[i]] = static_cast<double>(data[3 + i]) * scale;
+
+            return values;
+        }
+
+    private:
+        int fds_[PerfCounters::EVENTS_COUNT]{ -1, -1, -1, -1, -1 };
+        int leader_ = -1;
+        int error_ = 0;
+
+        // Which event each of the group's values is, in the order they opened
+        PerfCounters::Event order_[PerfCounters::EVENTS_COUNT]{};
+        std::size_t opened_ = 0;
+    };
+
+    const Group& thisThread()
+    {
+        thread_local const Group group{};
+        return group;
+    }
+
+} // namespace
+
+bool PerfCounters::available() noexcept
+{
+    return thisThread().available();
+}
+
+bool PerfCounters::available(Event event) noexcept
+{
+    return thisThread().available(event);
+}
+
+std::string PerfCounters::unavailableReason()
+{
+    auto error = thisThread().error();
+    if (available() || error == 0) return {};
+
+    // (ENOENT usually means no PMU, as in most VMs and containers)
+    return std::string("perf_event_open: ") + std::strerror(error);
+}
+
+PerfCounters::Values PerfCounters::read() noexcept
+{
+    return thisThread().read();
+}
+
+#else // !defined(__linux__)
+
+bool PerfCounters::available() noexcept
+{
+    return false;
+}
+
+bool PerfCounters::available(Event) noexcept
+{
+    return false;
+}
+
+std::string PerfCounters::unavailableReason()
+{
+    return "perf_event_open is Linux-only";
+}
+
+PerfCounters::Values PerfCounters::read() noexcept
+{
+    return {};
+}
+
+#endif // defined(__linux__)
+
+std::string PerfCounters::toString(Event event) noexcept
+{
+    switch (event)
+    {
+    case Cycles:        return "cycles";
+    case Instructions:  return "instructions";
+    case L1dMisses:     return "l1d_misses";
+    case LlcMisses:     return "llc_misses";
+    case BranchMisses:  return "branch_misses";
+
+    default:            return "unknown";
+    }
+}
+
+PerfCounters::Values& PerfCounters::Values::operator+=(const Values& other) noexcept
+{
+    for (std::size_t i = 0; i < EVENTS_COUNT; ++i)
+        counts[i] += other.counts[i];
+
+    return *this;
+}
+
+PerfCounters::Values& PerfCounters::Values::operator-=(const Values& other) noexcept
+{
+    for (std::size_t i = 0; i < EVENTS_COUNT; ++i)
+        counts[i] -= other.counts[i];
+
+    return *this;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+// Hardware performance counters for the calling thread, through Linux's
+// perf_event_open: cycles, instructions, L1 data cache and last-level cache
+// misses, and branch misses. Each read is a syscall, so this is opt-in
+// (--perf-counters).
+//
+// Counters often can't be opened (not Linux, no PMU exposed to a VM or
+// container, perf_event_paranoid too strict). Then available() is false and
+// reads are all zeros, so callers don't have to care. Counters the CPU
+// doesn't have are left out individually
+namespace PerfCounters
+{
+    enum Event
+    {
+        Cycles = 0,
+        Instructions,
+        L1dMisses,
+        LlcMisses,
+        BranchMisses,
+        EVENTS_COUNT
+    };
+
+    std::string toString(Event event) noexcept;
+
+    // Counts, scaled up if the kernel had to multiplex the counters (so not
+    // always whole numbers)
+    struct Values
+    {
+        double counts[EVENTS_COUNT]{};
+
+        Values& operator+=(const Values& other) noexcept;
+        Values& operator-=(const Values& other) noexcept;
+    };
+
+    // Whether the calling thread's counters opened (each thread opens its own
+    // on first use), and which ones
+    bool available() noexcept;
+    bool available(Event event) noexcept;
+
+    // Why not, if not
+    std::string unavailableReason();
+
+    // The calling thread's running totals. Take the difference of two reads
+    // to count a region. Never allocates
+    Values read() noexcept;
+
+} // namespace PerfCounters
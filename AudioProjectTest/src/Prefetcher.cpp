@@ -0,0 +1,103 @@
+#include "Prefetcher.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+Prefetcher::Prefetcher
+(
+    const std::vector<std::filesystem::path>& files,
+    std::vector<std::size_t> order,
+    std::size_t depth
+)
+    : files_(files)
+    , order_(std::move(order))
+    , depth_(depth)
+{
+    if (depth_ > 0 && !order_.empty())
+        thread_ = std::thread(&Prefetcher::run_, this);
+}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    moved_.notify_one();
+
+    if (thread_.joinable()) thread_.join();
+}
+
+void Prefetcher::reached(std::size_t position)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (position <= reached_) return;
+        reached_ = position;
+    }
+
+    moved_.notify_one();
+}
+
+void Prefetcher::run_()
+{
+    // The file being analyzed is prefetched too: the first one has nothing to
+    // overlap with, and later ones have usually been hinted already
+    for (std::size_t next = 0; next < order_.size(); ++next)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            moved_.wait(lock, [this, next] { return stopping_ || next <= reached_ + depth_; });
+            if (stopping_) return;
+
+            // Fell behind (it's only a hint, so no point catching up)
+            next = std::max(next, reached_);
+        }
+
+        willNeed_(files_[order_[next]]);
+    }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+void Prefetcher::willNeed_(const std::filesystem::path& file)
+{
+    // Non-blocking, so a FIFO (or device) in the list can't hang the thread
+    // (and so the destructor) in open. Only regular files get the hint
+    auto fd = ::open(file.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd < 0) return;
+
+#if defined(POSIX_FADV_WILLNEED)
+
+    struct stat status{};
+
+    // A hint only; failure here doesn't matter
+    if (::fstat(fd, &status) == 0 && S_ISREG(status.st_mode))
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+#endif
+
+    ::close(fd);
+}
+
+#else
+
+void Prefetcher::willNeed_(const std::filesystem::path&)
+{
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Asks the OS to start reading files shortly before they're analyzed, so a
+// cold-cache read of the next few files overlaps with the FFTs on the current
+// one. A background thread opens each file and hints the whole thing with
+// posix_fadvise(WILLNEED), which queues the reads and returns. (Opening it
+// also warms the directory and inode caches for the checks that come later.)
+//
+// It never gets more than depth files ahead of the analysis, so a long list
+// can't flood the page cache and evict files before they're reached. Off
+// POSIX (no fadvise), it does nothing
+class Prefetcher
+{
+public:
+    // files are visited in order (as indices into files), which should be the
+    // order they'll be analyzed in
+    Prefetcher
+    (
+        const std::vector<std::filesystem::path>& files,
+        std::vector<std::size_t> order,
+        std::size_t depth
+    );
+
+    virtual ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    // The analysis has started on order[position], so files up to
+    // order[position + depth] may now be prefetched. Cheap, and fine to call
+    // from any thread, in any order
+    void reached(std::size_t position);
+
+private:
+    const std::vector<std::filesystem::path>& files_;
+    std::vector<std::size_t> order_;
+    std::size_t depth_;
+
+    std::mutex mutex_{};
+    std::condition_variable moved_{};
+    std::size_t reached_ = 0;
+    bool stopping_ = false;
+
+    std::thread thread_{};
+
+    void run_();
+    static void willNeed_(const std::filesystem::path& file);
+
+}; // class Prefetcher
@@ -0,0 +1,338 @@
+#include "AudioAnalyzer.h"
+#include "Detections.h"
+#include "Json.h"
+#include "Results.h"
+#include "Windowing.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+constexpr auto TEXT = "text";
+constexpr auto JSONL = "jsonl";
+constexpr auto CSV = "csv";
+constexpr auto BIN = "bin";
+
+constexpr char BIN_MAGIC[8] = { 'A', 'P', 'T', 'R', 'E', 'S', '\0', '\0' };
+
+// Shortest text that reads back as the same value (so no precision is lost,
+// and nothing locale-dependent)
+template <typename T>
+static void appendNumber_(std::string& out, T value)
+{
+    char digits[32]{};
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+// Quoted (with quotes doubled) only if it has to be
+static void appendCsvField_(std::string& out, const std::string& field)
+{
+    if (field.find_first_of(",\"\r\n") == std::string::npos)
+    {
+        out += field;
+        return;
+    }
+
+    out += '"';
+
+    for (auto c : field)
+    {
+        if (c == '"') out += '"';
+        out += c;
+    }
+
+    out += '"';
+}
+
+// Byte by byte, so the layout is the same whatever the host's byte order
+template <typename T>
+static void appendLittleEndian_(std::string& out, T value)
+{
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8);
+
+    using Bits = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+    Bits bits{};
+    std::memcpy(&bits, &value, sizeof(T));
+
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+        out += static_cast<char>((bits >> (i * 8)) & 0xFF);
+}
+
+static void padTo8_(std::string& out, std::size_t recordStart)
+{
+    while ((out.size() - recordStart) % 8 != 0)
+        out += '\0';
+}
+
+namespace Results
+{
+    std::string toString(Format format) noexcept
+    {
+        switch (format)
+        {
+        case Jsonl:     return JSONL;
+        case Csv:       return CSV;
+        case Bin:       return BIN;
+
+        default:
+        case Text:      return TEXT;
+        }
+    }
+
+    Format fromString(const std::string& string) noexcept
+    {
+        auto normalized = string;
+
+        std::transform
+        (
+            normalized.begin(),
+            normalized.end(),
+            normalized.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); }
+        );
+
+        if (normalized == JSONL)        return Jsonl;
+        else if (normalized == CSV)     return Csv;
+        else if (normalized == BIN)     return Bin;
+        else                            return Text;
+    }
+
+    Writer::Writer(Format format, std::FILE* out, bool startTimes)
+        : format_(format)
+        , out_(out)
+        , startTimes_(startTimes)
+    {
+        buffer_.reserve(FLUSH_BYTES_ * 2);
+
+        // (Even with no files, so the output is still a valid empty table or
+        // results file)
+        if (format_ == Csv)
+        {
+            buffer_ += "file,error,fft_size,window,overlap,chunk_seconds,chunks,skipped_chunks,"
+                "static_chunks,static_seconds,longest_interval_seconds,intervals";
+
+            if (startTimes_) buffer_ += ",start_times";
+            buffer_ += '\n';
+        }
+        else if (format_ == Bin)
+        {
+            buffer_.append(BIN_MAGIC, sizeof(BIN_MAGIC));
+            appendLittleEndian_(buffer_, BIN_VERSION);
+            appendLittleEndian_(buffer_, std::uint32_t(0));
+        }
+    }
+
+    Writer::~Writer()
+    {
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    void Writer::write(const AudioAnalyzer::Analysis& analysis)
+    {
+        switch (format_)
+        {
+        case Jsonl: writeJsonl_(analysis); break;
+        case Csv:   writeCsv_(analysis); break;
+        case Bin:   writeBin_(analysis); break;
+
+        default:
+        case Text:
+            throw std::logic_error("Text output goes through operator<<");
+        }
+
+        if (buffer_.size() >= FLUSH_BYTES_) flush();
+    }
+
+    void Writer::flush()
+    {
+        if (buffer_.empty()) return;
+
+        auto written = std::fwrite(buffer_.data(), 1, buffer_.size(), out_);
+        auto ok = (written == buffer_.size()) && (std::fflush(out_) == 0);
+        buffer_.clear();
+
+        if (!ok) throw std::runtime_error("Unable to write results.");
+    }
+
+    void Writer::writeJsonl_(const AudioAnalyzer::Analysis& analysis)
+    {
+        auto& out = buffer_;
+        auto intervals = analysis.staticFrames.intervals();
+
+        out += "{\"file\":";
+        Json::appendQuoted(out, analysis.file.string());
+
+        if (!analysis.error.empty())
+        {
+            out += ",\"error\":";
+            Json::appendQuoted(out, analysis.error);
+        }
+
+        out += ",\"fftSize\":";
+        appendNumber_(out, analysis.fftSize);
+        out += ",\"window\":";
+        Json::appendQuoted(out, Windowing::toString(analysis.windowType));
+        out += ",\"overlap\":";
+        appendNumber_(out, analysis.overlapDecPercent);
+        out += ",\"chunkSeconds\":";
+        appendNumber_(out, analysis.chunkDurationSeconds);
+        out += ",\"chunks\":";
+        appendNumber_(out, analysis.chunksCount);
+        out += ",\"skippedChunks\":";
+        appendNumber_(out, analysis.skippedChunksCount);
+        out += ",\"staticChunks\":";
+        appendNumber_(out, analysis.staticFrames.count());
+        out += ",\"staticSeconds\":";
+        appendNumber_(out, analysis.staticFrames.staticSeconds());
+        out += ",\"longestIntervalSeconds\":";
+        appendNumber_(out, analysis.staticFrames.longestIntervalSeconds());
+        out += ",\"intervals\":[";
+
+        for (std::size_t i = 0; i < intervals.size(); ++i)
+        {
+            if (i > 0) out += ',';
+            out += '[';
+            appendNumber_(out, intervals[i].startSeconds);
+            out += ',';
+            appendNumber_(out, intervals[i].endSeconds);
+            out += ']';
+        }
+
+        out += ']';
+
+        if (analysis.staticChunkStartTimes)
+        {
+            out += ",\"startTimes\":[";
+
+            for (std::size_t i = 0; i < analysis.staticChunkStartTimes->size(); ++i)
+            {
+                if (i > 0) out += ',';
+                appendNumber_(out, (*analysis.staticChunkStartTimes)[i]);
+            }
+
+            out += ']';
+        }
+
+        out += "}\n";
+    }
+
+    void Writer::writeCsv_(const AudioAnalyzer::Analysis& analysis)
+    {
+        auto& out = buffer_;
+
+        appendCsvField_(out, analysis.file.string());
+        out += ',';
+        appendCsvField_(out, analysis.error);
+        out += ',';
+        appendNumber_(out, analysis.fftSize);
+        out += ',';
+        out += Windowing::toString(analysis.windowType);
+        out += ',';
+        appendNumber_(out, analysis.overlapDecPercent);
+        out += ',';
+        appendNumber_(out, analysis.chunkDurationSeconds);
+        out += ',';
+        appendNumber_(out, analysis.chunksCount);
+        out += ',';
+        appendNumber_(out, analysis.skippedChunksCount);
+        out += ',';
+        appendNumber_(out, analysis.staticFrames.count());
+        out += ',';
+        appendNumber_(out, analysis.staticFrames.staticSeconds());
+        out += ',';
+        appendNumber_(out, analysis.staticFrames.longestIntervalSeconds());
+        out += ',';
+
+        auto intervals = analysis.staticFrames.intervals();
+
+        for (std::size_t i = 0; i < intervals.size(); ++i)
+        {
+            if (i > 0) out += ' ';
+            appendNumber_(out, intervals[i].startSeconds);
+            out += '-';
+            appendNumber_(out, intervals[i].endSeconds);
+        }
+
+        if (startTimes_)
+        {
+            out += ',';
+
+            if (analysis.staticChunkStartTimes)
+            {
+                for (std::size_t i = 0; i < analysis.staticChunkStartTimes->size(); ++i)
+                {
+                    if (i > 0) out += ' ';
+                    appendNumber_(out, (*analysis.staticChunkStartTimes)[i]);
+                }
+            }
+        }
+
+        out += '\n';
+    }
+
+    void Writer::writeBin_(const AudioAnalyzer::Analysis& analysis)
+    {
+        auto& out = buffer_;
+
+        auto intervals = analysis.staticFrames.intervals();
+        auto path = analysis.file.u8string();
+        auto start_times_count = analysis.staticChunkStartTimes ? analysis.staticChunkStartTimes->size() : 0;
+
+        // Filled in once the record's size is known
+        auto record_start = out.size();
+        appendLittleEndian_(out, std::uint64_t(0));
+
+        appendLittleEndian_(out, std::uint64_t(analysis.chunksCount));
+        appendLittleEndian_(out, std::uint64_t(analysis.skippedChunksCount));
+        appendLittleEndian_(out, std::uint64_t(analysis.staticFrames.count()));
+        appendLittleEndian_(out, std::uint64_t(intervals.size()));
+        appendLittleEndian_(out, std::uint64_t(start_times_count));
+        appendLittleEndian_(out, analysis.staticFrames.staticSeconds());
+        appendLittleEndian_(out, analysis.staticFrames.longestIntervalSeconds());
+        appendLittleEndian_(out, std::uint32_t(analysis.fftSize));
+        appendLittleEndian_(out, std::uint32_t(analysis.windowType));
+        appendLittleEndian_(out, analysis.overlapDecPercent);
+        appendLittleEndian_(out, analysis.chunkDurationSeconds);
+        appendLittleEndian_(out, std::uint32_t(path.size()));
+        appendLittleEndian_(out, std::uint32_t(analysis.error.size()));
+
+        for (auto& interval : intervals)
+        {
+            appendLittleEndian_(out, std::uint64_t(interval.firstFrame));
+            appendLittleEndian_(out, std::uint64_t(interval.endFrame));
+            appendLittleEndian_(out, interval.startSeconds);
+            appendLittleEndian_(out, interval.endSeconds);
+        }
+
+        for (std::size_t i = 0; i < start_times_count; ++i)
+            appendLittleEndian_(out, (*analysis.staticChunkStartTimes)[i]);
+
+        padTo8_(out, record_start);
+
+        out.append(path.begin(), path.end());
+        out += analysis.error;
+        padTo8_(out, record_start);
+
+        // Now the size
+        auto record_bytes = static_cast<std::uint64_t>(out.size() - record_start);
+
+        for (std::size_t i = 0; i < 8; ++i)
+            out[record_start + i] = static_cast<char>((record_bytes >> (i * 8)) & 0xFF);
+    }
+
+} // namespace Results
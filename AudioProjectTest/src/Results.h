@@ -0,0 +1,95 @@
+#pragma once
+
+#include "AudioAnalyzer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Analyses in formats meant for other programs rather than people (Text is
+// operator<<). Numbers go through std::to_chars into one reusable buffer,
+// which is written out in large blocks instead of a flush per file.
+//
+// Jsonl: one object per file, per line.
+//
+// Csv: a header, then one row per file. Intervals are "start-end" pairs
+// (seconds) separated by spaces.
+//
+// Bin: fixed layout, little-endian, everything 8-byte aligned, so a loader
+// can map the file and walk it without parsing. A 16-byte header:
+//
+//   char[8]  magic "APTRES\0\0"
+//   u32      version (1)
+//   u32      reserved (0)
+//
+// then one record per file:
+//
+//   u64      recordBytes (all of it, so records can be skipped)
+//   u64      chunksCount
+//   u64      skippedChunksCount
+//   u64      staticChunksCount
+//   u64      intervalsCount
+//   u64      startTimesCount (0 without --start-times)
+//   f64      staticSeconds
+//   f64      longestIntervalSeconds
+//   u32      fftSize
+//   u32      window (Windowing::Window)
+//   f32      overlap
+//   f32      chunkSeconds
+//   u32      pathBytes
+//   u32      errorBytes (0 if the file was analyzed)
+//
+//   intervalsCount x { u64 firstChunk, u64 endChunk, f32 startSeconds, f32 endSeconds }
+//   startTimesCount x f32, zero-padded to 8 bytes
+//   path, then error (UTF-8, no terminators), zero-padded to 8 bytes
+namespace Results
+{
+    enum Format
+    {
+        Text = 0,
+        Jsonl,
+        Csv,
+        Bin
+    };
+
+    constexpr std::uint32_t BIN_VERSION = 1;
+
+    std::string toString(Format format) noexcept;
+    Format fromString(const std::string& string) noexcept;
+
+    class Writer
+    {
+    public:
+        // startTimes is whether analyses come with start times (only matters
+        // for the CSV header). CSV and binary headers are buffered right away
+        Writer(Format format, std::FILE* out, bool startTimes = false);
+
+        // Flushes whatever's left (ignoring errors; call flush to see them)
+        virtual ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        // Adds to the buffer, writing it out once it's big enough
+        void write(const AudioAnalyzer::Analysis& analysis);
+
+        // Writes out the buffer in one go. Throws if the write fails
+        void flush();
+
+    private:
+        // Buffers are written once they get this big
+        static constexpr std::size_t FLUSH_BYTES_ = std::size_t(1) << 20;
+
+        Format format_;
+        std::FILE* out_;
+        bool startTimes_;
+        std::string buffer_{};
+
+        void writeJsonl_(const AudioAnalyzer::Analysis& analysis);
+        void writeCsv_(const AudioAnalyzer::Analysis& analysis);
+        void writeBin_(const AudioAnalyzer::Analysis& analysis);
+
+    }; // class Writer
+
+} // namespace Results
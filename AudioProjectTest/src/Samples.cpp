@@ -0,0 +1,127 @@
+#include "Samples.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <string>
+
+constexpr auto INT16 = "s16le";
+constexpr auto INT16_BIG_ENDIAN = "s16be";
+constexpr auto INT8 = "s8";
+constexpr auto INT24 = "s24le";
+constexpr auto FLOAT32 = "f32le";
+constexpr auto MU_LAW = "mulaw";
+constexpr auto A_LAW = "alaw";
+
+struct Table_
+{
+    float values[256]{};
+};
+
+// ITU-T G.711 expansion (as in the reference g711.c): the bits are inverted,
+// then it's sign, 3 bits of segment and 4 of mantissa, with a bias of 0x84
+static constexpr float muLaw_(unsigned byte)
+{
+    auto u = ~byte & 0xFF;
+    auto t = static_cast<int>(((u & 0x0F) << 3) + 0x84) << ((u & 0x70) >> 4);
+
+    return static_cast<float>((u & 0x80) ? (0x84 - t) : (t - 0x84));
+}
+
+// Even bits inverted, then sign (set for positive), segment and mantissa
+static constexpr float aLaw_(unsigned byte)
+{
+    auto a = byte ^ 0x55;
+    auto t = static_cast<int>((a & 0x0F) << 4);
+    auto segment = static_cast<int>((a & 0x70) >> 4);
+
+    if (segment == 0) t += 8;
+    else t = (t + 0x108) << (segment - 1);
+
+    return static_cast<float>((a & 0x80) ? t : -t);
+}
+
+template <typename Decode>
+static constexpr Table_ table_(Decode decode)
+{
+    Table_ table{};
+
+    for (unsigned byte = 0; byte < 256; ++byte)
+        table.values[byte] = decode(byte);
+
+    return table;
+}
+
+// Built at compile time, so they're ready before anything could use them
+static constexpr auto MU_LAW_TABLE_ = table_(muLaw_);
+static constexpr auto A_LAW_TABLE_ = table_(aLaw_);
+
+namespace Samples
+{
+    std::size_t bytesPerSample(Format format) noexcept
+    {
+        switch (format)
+        {
+        case Int24:     return 3;
+        case Float32:   return 4;
+
+        case Int8:
+        case MuLaw:
+        case ALaw:
+            return 1;
+
+        default:
+        case Int16:
+        case Int16BigEndian:
+            return 2;
+        }
+    }
+
+    const float* decodeTable(Format format) noexcept
+    {
+        switch (format)
+        {
+        case MuLaw: return MU_LAW_TABLE_.values;
+        case ALaw:  return A_LAW_TABLE_.values;
+        default:    return nullptr;
+        }
+    }
+
+    std::string toString(Format format) noexcept
+    {
+        switch (format)
+        {
+        case Int16BigEndian:    return INT16_BIG_ENDIAN;
+        case Int8:              return INT8;
+        case Int24:             return INT24;
+        case Float32:           return FLOAT32;
+        case MuLaw:             return MU_LAW;
+        case ALaw:              return A_LAW;
+
+        default:
+        case Int16:             return INT16;
+        }
+    }
+
+    Format fromString(const std::string& string) noexcept
+    {
+        auto normalized = string;
+
+        std::transform
+        (
+            normalized.begin(),
+            normalized.end(),
+            normalized.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); }
+        );
+
+        if (normalized == INT16_BIG_ENDIAN)                     return Int16BigEndian;
+        else if (normalized == INT8)                            return Int8;
+        else if (normalized == INT24)                           return Int24;
+        else if (normalized == FLOAT32)                         return Float32;
+        else if (normalized == MU_LAW || normalized == "ulaw")  return MuLaw;
+        else if (normalized == A_LAW)                           return ALaw;
+        else                                                    return Int16;
+    }
+
+} // namespace Samples
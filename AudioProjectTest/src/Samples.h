@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Encodings of headerless input. Every format decodes to the same scale as
+// Int16 (full scale is 32768), so the static threshold, the energy gate and
+// the spectrogram's log scale mean the same thing whatever the input was.
+// The decoding itself happens in the convert kernels (see SimdKernels.h),
+// each format getting its own
+namespace Samples
+{
+    enum Format
+    {
+        Int16 = 0, // Signed, little-endian (linear16)
+        Int16BigEndian,
+        Int8, // Signed, scaled up by 256
+        Int24, // Signed, little-endian, packed in 3 bytes, scaled down by 256
+        Float32, // Little-endian, [-1.0, 1.0] scaled up by 32768
+        MuLaw, // G.711 (through a table)
+        ALaw, // G.711 (through a table)
+        FORMATS_COUNT
+    };
+
+    std::size_t bytesPerSample(Format format) noexcept;
+
+    // The decoded value of each of the 256 bytes, for MuLaw and ALaw (null
+    // for anything else). The same 16-bit values as ITU-T G.711's reference
+    // expansion
+    const float* decodeTable(Format format) noexcept;
+
+    std::string toString(Format format) noexcept;
+    Format fromString(const std::string& string) noexcept;
+
+} // namespace Samples
@@ -0,0 +1,203 @@
+#include "Simd.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#define HAVE_X86
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#endif
+
+constexpr auto AUTO = "auto";
+constexpr auto SCALAR = "scalar";
+constexpr auto SSE41 = "sse4.1";
+constexpr auto AVX2 = "avx2";
+constexpr auto AVX512 = "avx512";
+
+#if defined(HAVE_X86)
+
+// What cpuid says, plus whether the OS saves the wider registers on context
+// switches (without which the instructions can't be used, even if present)
+struct Features_
+{
+    bool sse41 = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool avx512 = false;
+};
+
+static void cpuid_(unsigned leaf, unsigned subleaf, unsigned (&regs)[4])
+{
+#if defined(_MSC_VER)
+    int out[4]{};
+    __cpuidex(out, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (auto i = 0; i < 4; ++i) regs[i] = static_cast<unsigned>(out[i]);
+#else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static std::uint64_t xgetbv_()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    // (The intrinsic needs -mxsave)
+    unsigned eax = 0, edx = 0;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<std::uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+static Features_ detect_()
+{
+    Features_ features{};
+    unsigned regs[4]{};
+
+    cpuid_(0, 0, regs);
+    auto max_leaf = regs[0];
+    if (max_leaf < 1) return features;
+
+    cpuid_(1, 0, regs);
+    auto ecx1 = regs[2];
+    features.sse41 = ecx1 & (1u << 19);
+
+    auto os_saves_ymm = false;
+    auto os_saves_zmm = false;
+
+    if ((ecx1 & (1u << 27)) && (ecx1 & (1u << 28))) // OSXSAVE, AVX
+    {
+        // XMM and YMM state, then opmask and both halves of the ZMM state
+        auto xcr0 = xgetbv_();
+        os_saves_ymm = (xcr0 & 0x6) == 0x6;
+        os_saves_zmm = (xcr0 & 0xE6) == 0xE6;
+    }
+
+    if (!os_saves_ymm || max_leaf < 7) return features;
+
+    features.fma = ecx1 & (1u << 12);
+
+    cpuid_(7, 0, regs);
+    auto ebx7 = regs[1];
+    features.avx2 = ebx7 & (1u << 5);
+
+    // F, BW, VL
+    constexpr auto avx512_bits = (1u << 16) | (1u << 30) | (1u << 31);
+    features.avx512 = os_saves_zmm && ((ebx7 & avx512_bits) == avx512_bits);
+
+    return features;
+}
+
+static const Features_& features_()
+{
+    static const auto features = detect_();
+    return features;
+}
+
+#endif // defined(HAVE_X86)
+
+namespace Simd
+{
+    Level best() noexcept
+    {
+        if (supported(Avx512)) return Avx512;
+        if (supported(Avx2)) return Avx2;
+        if (supported(Sse41)) return Sse41;
+        return Scalar;
+    }
+
+    bool supported(Level level) noexcept
+    {
+        switch (level)
+        {
+        case Auto:
+        case Scalar:
+            return true;
+
+#if defined(HAVE_X86)
+
+        case Sse41:
+            return features_().sse41;
+        case Avx2:
+            return features_().avx2 && features_().fma;
+        case Avx512:
+            return features_().avx512 && features_().fma;
+
+#endif // defined(HAVE_X86)
+
+        default:
+            return false;
+        }
+    }
+
+    const Kernels& kernels(Level level)
+    {
+        if (level == Auto) level = best();
+
+        if (!supported(level))
+        {
+            std::ostringstream oss{};
+            oss << "This CPU does not support " << toString(level) << " SIMD.";
+            throw std::runtime_error(oss.str());
+        }
+
+        switch (level)
+        {
+        case Sse41:     return sse41Kernels();
+        case Avx2:      return avx2Kernels();
+        case Avx512:    return avx512Kernels();
+
+        default:
+        case Scalar:    return scalarKernels();
+        }
+    }
+
+    std::string toString(Level level) noexcept
+    {
+        switch (level)
+        {
+        case Scalar:    return SCALAR;
+        case Sse41:     return SSE41;
+        case Avx2:      return AVX2;
+        case Avx512:    return AVX512;
+
+        default:
+        case Auto:      return AUTO;
+        }
+    }
+
+    Level fromString(const std::string& string) noexcept
+    {
+        auto normalized = string;
+
+        std::transform
+        (
+            normalized.begin(),
+            normalized.end(),
+            normalized.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); }
+        );
+
+        if (normalized == SCALAR)                               return Scalar;
+        else if (normalized == SSE41 || normalized == "sse41")  return Sse41;
+        else if (normalized == AVX2)                            return Avx2;
+        else if (normalized == AVX512)                          return Avx512;
+        else                                                    return Auto;
+    }
+
+} // namespace Simd
+
+#undef HAVE_X86
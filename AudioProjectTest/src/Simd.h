@@ -0,0 +1,29 @@
+#pragma once
+
+#include "SimdKernels.h"
+
+#include <string>
+
+// Picks the widest kernel set the CPU (and OS) supports at run time, so one
+// binary runs everywhere
+namespace Simd
+{
+    enum Level
+    {
+        Auto = 0, // Whatever best() says
+        Scalar,
+        Sse41,
+        Avx2, // (With FMA)
+        Avx512 // (F, BW and VL)
+    };
+
+    Level best() noexcept;
+    bool supported(Level level) noexcept;
+
+    // Throws std::runtime_error if the CPU doesn't support level
+    const Kernels& kernels(Level level);
+
+    std::string toString(Level level) noexcept;
+    Level fromString(const std::string& string) noexcept;
+
+} // namespace Simd
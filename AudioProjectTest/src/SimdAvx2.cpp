@@ -0,0 +1,230 @@
+#include "Samples.h"
+#include "SimdKernels.h"
+#include "SimdSamples.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#include <immintrin.h>
+
+// Built with -mavx2 -mfma. 8 floats per register
+namespace
+{
+    // Decodes 8 samples
+    template <Samples::Format Format>
+    inline __m256 decode(const unsigned char* samples, const float* table)
+    {
+        if constexpr (Format == Samples::Int16 || Format == Samples::Int16BigEndian)
+        {
+            auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples));
+
+            // (Swapping each 16-bit lane's bytes)
+            if constexpr (Format == Samples::Int16BigEndian)
+                packed = _mm_or_si128(_mm_slli_epi16(packed, 8), _mm_srli_epi16(packed, 8));
+
+            return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(packed));
+        }
+        else if constexpr (Format == Samples::Int8)
+        {
+            // (Shifted up into the Int16 range before converting, so exact)
+            auto packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples));
+            return _mm256_cvtepi32_ps(_mm256_slli_epi32(_mm256_cvtepi8_epi32(packed), 8));
+        }
+        else if constexpr (Format == Samples::Int24)
+        {
+            // Bytes 0-15 in the low half and 8-23 in the high half, then each
+            // sample's 3 bytes to the top of a 32-bit lane (pshufb works
+            // within halves)
+            auto bytes = _mm256_inserti128_si256
+            (
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samples))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + 8)),
+                1
+            );
+
+            auto spread = _mm256_setr_epi8
+            (
+                -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                -1, 4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15
+            );
+
+            auto shifted = _mm256_shuffle_epi8(bytes, spread);
+            return _mm256_mul_ps(_mm256_cvtepi32_ps(shifted), _mm256_set1_ps(INT24_SCALE));
+        }
+        else if constexpr (Format == Samples::Float32)
+        {
+            auto values = _mm256_loadu_ps(reinterpret_cast<const float*>(samples));
+            return _mm256_mul_ps(values, _mm256_set1_ps(FLOAT32_SCALE));
+        }
+        else
+        {
+            // The bytes are the table indices
+            auto indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples)));
+            return _mm256_i32gather_ps(table, indices, 4);
+        }
+    }
+
+    inline float sum(__m256 v)
+    {
+        auto half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(1, 1, 1, 1)));
+        return _mm_cvtss_f32(half);
+    }
+
+    // Fixed (when not 0) replaces count with a compile-time constant, for
+    // the whole-frame versions
+    template <Samples::Format Format, std::size_t Fixed = 0>
+    float convert(const unsigned char* samples, std::size_t count, float* out)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        constexpr auto bytes = BYTES_PER_SAMPLE<Format>;
+        auto table = decodeTable<Format>();
+        auto energy = _mm256_setzero_ps();
+        std::size_t i = 0;
+
+        for (; i + 7 < count; i += 8)
+        {
+            auto converted = decode<Format>(samples + (i * bytes), table);
+            _mm256_storeu_ps(out + i, converted);
+            energy = _mm256_fmadd_ps(converted, converted, energy);
+        }
+
+        auto tail_energy = 0.0f;
+
+        // Whole frames are always a multiple of 8
+        if constexpr (Fixed == 0 || Fixed % 8 != 0)
+        {
+            for (; i < count; ++i)
+            {
+                out[i] = decodeSample<Format>(samples + (i * bytes), table);
+                tail_energy += out[i] * out[i];
+            }
+        }
+
+        return sum(energy) + tail_energy;
+    }
+
+    template <Samples::Format Format, std::size_t Fixed = 0>
+    float convertWindowed
+    (
+        const unsigned char* samples,
+        const float* window,
+        std::size_t count,
+        float* out
+    )
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        constexpr auto bytes = BYTES_PER_SAMPLE<Format>;
+        auto table = decodeTable<Format>();
+        auto energy = _mm256_setzero_ps();
+        std::size_t i = 0;
+
+        for (; i + 7 < count; i += 8)
+        {
+            auto windowed = _mm256_mul_ps(decode<Format>(samples + (i * bytes), table), _mm256_loadu_ps(window + i));
+            _mm256_storeu_ps(out + i, windowed);
+            energy = _mm256_fmadd_ps(windowed, windowed, energy);
+        }
+
+        auto tail_energy = 0.0f;
+
+        if constexpr (Fixed == 0 || Fixed % 8 != 0)
+        {
+            for (; i < count; ++i)
+            {
+                out[i] = decodeSample<Format>(samples + (i * bytes), table) * window[i];
+                tail_energy += out[i] * out[i];
+            }
+        }
+
+        return sum(energy) + tail_energy;
+    }
+
+    void zero(float* out, std::size_t count)
+    {
+        auto zeros = _mm256_setzero_ps();
+        std::size_t i = 0;
+
+        for (; i + 7 < count; i += 8)
+            _mm256_storeu_ps(out + i, zeros);
+
+        for (; i < count; ++i)
+            out[i] = 0.0f;
+    }
+
+    template <std::size_t Fixed = 0>
+    void magnitudes(const float* real, const float* imag, std::size_t count, float* out)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        std::size_t k = 0;
+
+        for (; k + 7 < count; k += 8)
+        {
+            auto re = _mm256_loadu_ps(real + k);
+            auto im = _mm256_loadu_ps(imag + k);
+
+            auto power = _mm256_fmadd_ps(re, re, _mm256_mul_ps(im, im));
+            _mm256_storeu_ps(out + k, _mm256_sqrt_ps(power));
+        }
+
+        for (; k < count; ++k)
+        {
+            auto power = (real[k] * real[k]) + (imag[k] * imag[k]);
+            out[k] = _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(power)));
+        }
+    }
+
+    template <std::size_t Fixed = 0>
+    bool allAbove(const float* real, const float* imag, std::size_t count, float thresholdSq)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        auto threshold_sq = _mm256_set1_ps(thresholdSq);
+        std::size_t k = 0;
+
+        // (No FMA here, so the verdict matches the scalar kernel exactly)
+        for (; k + 7 < count; k += 8)
+        {
+            auto re = _mm256_loadu_ps(real + k);
+            auto im = _mm256_loadu_ps(imag + k);
+
+            auto power = _mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im));
+            auto above = _mm256_cmp_ps(power, threshold_sq, _CMP_GT_OQ);
+
+            if (_mm256_movemask_ps(above) != 0xFF) return false;
+        }
+
+        for (; k < count; ++k)
+        {
+            if (!((real[k] * real[k]) + (imag[k] * imag[k]) > thresholdSq)) return false;
+        }
+
+        return true;
+    }
+
+#include "SimdTables.h"
+
+} // namespace
+
+const Simd::Kernels& Simd::avx2Kernels() noexcept
+{
+    static constexpr auto kernels = kernelTable();
+
+    return kernels;
+}
+
+#else
+
+// Never selected off x86
+const Simd::Kernels& Simd::avx2Kernels() noexcept
+{
+    return scalarKernels();
+}
+
+#endif
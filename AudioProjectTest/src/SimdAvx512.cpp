@@ -0,0 +1,223 @@
+#include "Samples.h"
+#include "SimdKernels.h"
+#include "SimdSamples.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#include <immintrin.h>
+
+// Built with -mavx512f -mavx512bw -mavx512vl. 16 floats per register, and
+// tails are done with masked loads and stores instead of scalar loops, so a
+// short (remainder) chunk costs one extra masked step at most
+namespace
+{
+    // The lowest count bits (count <= 16)
+    inline __mmask16 tailMask(std::size_t count)
+    {
+        return static_cast<__mmask16>((1u << count) - 1u);
+    }
+
+    // Decodes up to 16 samples (count of them, 16 for a full step), reading
+    // nothing past them. The rest of the register is zeros
+    template <Samples::Format Format>
+    inline __m512 decode(const unsigned char* samples, const float* table, std::size_t count)
+    {
+        auto mask = tailMask(count);
+
+        if constexpr (Format == Samples::Int16 || Format == Samples::Int16BigEndian)
+        {
+            auto packed = _mm256_maskz_loadu_epi16(mask, samples);
+
+            // (Swapping each 16-bit lane's bytes)
+            if constexpr (Format == Samples::Int16BigEndian)
+                packed = _mm256_or_si256(_mm256_slli_epi16(packed, 8), _mm256_srli_epi16(packed, 8));
+
+            return _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(packed));
+        }
+        else if constexpr (Format == Samples::Int8)
+        {
+            // (Shifted up into the Int16 range before converting, so exact)
+            auto packed = _mm_maskz_loadu_epi8(mask, samples);
+            return _mm512_cvtepi32_ps(_mm512_slli_epi32(_mm512_cvtepi8_epi32(packed), 8));
+        }
+        else if constexpr (Format == Samples::Int24)
+        {
+            // All 48 bytes at once, then every 12 bytes (3 dwords) moved to
+            // their own 128-bit lane, and each sample's 3 bytes to the top
+            // of a 32-bit lane (pshufb works within 128-bit lanes)
+            auto byte_mask = (std::uint64_t(1) << (3 * count)) - 1;
+            auto bytes = _mm512_maskz_loadu_epi8(byte_mask, samples);
+
+            auto lanes = _mm512_permutexvar_epi32
+            (
+                _mm512_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0, 6, 7, 8, 0, 9, 10, 11, 0),
+                bytes
+            );
+
+            auto spread = _mm512_broadcast_i32x4(_mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11));
+            auto shifted = _mm512_shuffle_epi8(lanes, spread);
+
+            return _mm512_mul_ps(_mm512_cvtepi32_ps(shifted), _mm512_set1_ps(INT24_SCALE));
+        }
+        else if constexpr (Format == Samples::Float32)
+        {
+            auto values = _mm512_maskz_loadu_ps(mask, samples);
+            return _mm512_mul_ps(values, _mm512_set1_ps(FLOAT32_SCALE));
+        }
+        else
+        {
+            // The bytes are the table indices
+            auto indices = _mm512_cvtepu8_epi32(_mm_maskz_loadu_epi8(mask, samples));
+            return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, indices, table, 4);
+        }
+    }
+
+    // Fixed (when not 0) replaces count with a compile-time constant, for
+    // the whole-frame versions. (Masked-off lanes are zeros, so they add
+    // nothing to the energy)
+    template <Samples::Format Format, std::size_t Fixed = 0>
+    float convert(const unsigned char* samples, std::size_t count, float* out)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        constexpr auto bytes = BYTES_PER_SAMPLE<Format>;
+        auto table = decodeTable<Format>();
+        auto energy = _mm512_setzero_ps();
+        std::size_t i = 0;
+
+        for (; i + 15 < count; i += 16)
+        {
+            auto converted = decode<Format>(samples + (i * bytes), table, 16);
+            _mm512_storeu_ps(out + i, converted);
+            energy = _mm512_fmadd_ps(converted, converted, energy);
+        }
+
+        if (i < count)
+        {
+            auto mask = tailMask(count - i);
+            auto converted = decode<Format>(samples + (i * bytes), table, count - i);
+            _mm512_mask_storeu_ps(out + i, mask, converted);
+            energy = _mm512_fmadd_ps(converted, converted, energy);
+        }
+
+        return _mm512_reduce_add_ps(energy);
+    }
+
+    template <Samples::Format Format, std::size_t Fixed = 0>
+    float convertWindowed
+    (
+        const unsigned char* samples,
+        const float* window,
+        std::size_t count,
+        float* out
+    )
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        constexpr auto bytes = BYTES_PER_SAMPLE<Format>;
+        auto table = decodeTable<Format>();
+        auto energy = _mm512_setzero_ps();
+        std::size_t i = 0;
+
+        for (; i + 15 < count; i += 16)
+        {
+            auto windowed = _mm512_mul_ps(decode<Format>(samples + (i * bytes), table, 16), _mm512_loadu_ps(window + i));
+            _mm512_storeu_ps(out + i, windowed);
+            energy = _mm512_fmadd_ps(windowed, windowed, energy);
+        }
+
+        if (i < count)
+        {
+            auto mask = tailMask(count - i);
+            auto decoded = decode<Format>(samples + (i * bytes), table, count - i);
+            auto windowed = _mm512_mul_ps(decoded, _mm512_maskz_loadu_ps(mask, window + i));
+            _mm512_mask_storeu_ps(out + i, mask, windowed);
+            energy = _mm512_fmadd_ps(windowed, windowed, energy);
+        }
+
+        return _mm512_reduce_add_ps(energy);
+    }
+
+    void zero(float* out, std::size_t count)
+    {
+        auto zeros = _mm512_setzero_ps();
+        std::size_t i = 0;
+
+        for (; i + 15 < count; i += 16)
+            _mm512_storeu_ps(out + i, zeros);
+
+        if (i < count)
+            _mm512_mask_storeu_ps(out + i, tailMask(count - i), zeros);
+    }
+
+    template <std::size_t Fixed = 0>
+    void magnitudes(const float* real, const float* imag, std::size_t count, float* out)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        std::size_t k = 0;
+
+        for (; k + 15 < count; k += 16)
+        {
+            auto re = _mm512_loadu_ps(real + k);
+            auto im = _mm512_loadu_ps(imag + k);
+            _mm512_storeu_ps(out + k, _mm512_sqrt_ps(_mm512_fmadd_ps(re, re, _mm512_mul_ps(im, im))));
+        }
+
+        if (k < count)
+        {
+            auto mask = tailMask(count - k);
+            auto re = _mm512_maskz_loadu_ps(mask, real + k);
+            auto im = _mm512_maskz_loadu_ps(mask, imag + k);
+            _mm512_mask_storeu_ps(out + k, mask, _mm512_sqrt_ps(_mm512_fmadd_ps(re, re, _mm512_mul_ps(im, im))));
+        }
+    }
+
+    template <std::size_t Fixed = 0>
+    bool allAbove(const float* real, const float* imag, std::size_t count, float thresholdSq)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        auto threshold_sq = _mm512_set1_ps(thresholdSq);
+
+        // (No FMA, so the verdict matches the scalar kernel exactly)
+        for (std::size_t k = 0; k < count; k += 16)
+        {
+            auto left = count - k;
+            auto wanted = (left >= 16) ? __mmask16(0xFFFF) : tailMask(left);
+
+            auto re = _mm512_maskz_loadu_ps(wanted, real + k);
+            auto im = _mm512_maskz_loadu_ps(wanted, imag + k);
+
+            auto power = _mm512_add_ps(_mm512_mul_ps(re, re), _mm512_mul_ps(im, im));
+            auto above = _mm512_cmp_ps_mask(power, threshold_sq, _CMP_GT_OQ);
+
+            if ((above & wanted) != wanted) return false;
+        }
+
+        return true;
+    }
+
+#include "SimdTables.h"
+
+} // namespace
+
+const Simd::Kernels& Simd::avx512Kernels() noexcept
+{
+    static constexpr auto kernels = kernelTable();
+
+    return kernels;
+}
+
+#else
+
+// Never selected off x86
+const Simd::Kernels& Simd::avx512Kernels() noexcept
+{
+    return scalarKernels();
+}
+
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Samples.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// The per-ISA kernels. Each set lives in its own translation unit, compiled
+// for just that instruction set (see CMakeLists.txt), and is only ever called
+// once Simd has checked the CPU supports it.
+//
+// Keep this header (and the kernel files) free of anything inline from the
+// standard library: an inline function compiled with AVX2 enabled could end
+// up being the copy the linker keeps for the whole program
+namespace Simd
+{
+    // FFT sizes that also get whole-frame kernels with the trip counts fixed
+    // at compile time (so no tails, and the compiler can unroll)
+    constexpr std::size_t FIXED_FFT_SIZES[] = { 512, 1024, 2048 };
+    constexpr std::size_t FIXED_FFT_SIZES_COUNT = sizeof(FIXED_FFT_SIZES) / sizeof(FIXED_FFT_SIZES[0]);
+
+    // Decoding one format's samples (see Samples::Format) to floats. Each
+    // format has its own, with the decode fused into the loop. samples is
+    // count samples' worth of bytes, with no alignment required. Both return
+    // the sum of out[i]^2 (the energy), accumulated in whatever order suits
+    // the ISA
+    struct ConvertKernels
+    {
+        // out[i] = samples[i]
+        float (*convert)(const unsigned char* samples, std::size_t count, float* out);
+
+        // out[i] = samples[i] * window[i]
+        float (*convertWindowed)
+        (
+            const unsigned char* samples,
+            const float* window,
+            std::size_t count,
+            float* out
+        );
+    };
+
+    // The same, for exactly one full frame of fftSize samples
+    struct FrameConvertKernels
+    {
+        float (*convert)(const unsigned char* samples, float* out);
+        float (*convertWindowed)(const unsigned char* samples, const float* window, float* out);
+    };
+
+    // The kernels below, for exactly one full frame of fftSize samples (or
+    // fftSize / 2 + 1 bins)
+    struct FrameKernels
+    {
+        std::size_t fftSize = 0;
+        FrameConvertKernels converts[Samples::FORMATS_COUNT];
+        void (*magnitudes)(const float* real, const float* imag, float* out);
+        bool (*allAbove)(const float* real, const float* imag, float thresholdSq);
+    };
+
+    struct Kernels
+    {
+        // One per Samples::Format
+        ConvertKernels converts[Samples::FORMATS_COUNT];
+
+        void (*zero)(float* out, std::size_t count);
+
+        // The spectrum is split (structure of arrays): bin k is
+        // (real[k], imag[k])
+        void (*magnitudes)(const float* real, const float* imag, std::size_t count, float* out);
+
+        // Whether every bin's re^2 + im^2 is above thresholdSq (NaNs fail).
+        // Stops at the first bin that isn't
+        bool (*allAbove)(const float* real, const float* imag, std::size_t count, float thresholdSq);
+
+        // One per FIXED_FFT_SIZES
+        FrameKernels frames[FIXED_FFT_SIZES_COUNT];
+    };
+
+    // The matching frame kernels, or null if fftSize isn't one of the fixed
+    // sizes
+    inline const FrameKernels* frameKernels(const Kernels& kernels, std::size_t fftSize) noexcept
+    {
+        for (auto& frame : kernels.frames)
+            if (frame.fftSize == fftSize) return &frame;
+
+        return nullptr;
+    }
+
+    const Kernels& scalarKernels() noexcept;
+    const Kernels& sse41Kernels() noexcept;
+    const Kernels& avx2Kernels() noexcept;
+    const Kernels& avx512Kernels() noexcept;
+
+} // namespace Simd
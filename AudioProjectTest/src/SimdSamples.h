@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Samples.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// What the kernel files share about decoding samples: sizes, and a decoder
+// for one sample at a time (the scalar kernels, and the other sets' tails).
+// It's all in an unnamed namespace, so each kernel file gets its own copy,
+// compiled for its own instruction set (see SimdKernels.h)
+namespace
+{
+    template <Samples::Format Format>
+    constexpr std::size_t BYTES_PER_SAMPLE =
+        (Format == Samples::Int24) ? 3
+        : (Format == Samples::Float32) ? 4
+        : (Format == Samples::Int16 || Format == Samples::Int16BigEndian) ? 2
+        : 1;
+
+    template <Samples::Format Format>
+    constexpr bool IS_TABLE_DECODED = (Format == Samples::MuLaw || Format == Samples::ALaw);
+
+    // Int24 and Float32 to the Int16 scale. (Both exact: powers of 2)
+    constexpr auto INT24_SCALE = 1.0f / 65536.0f; // (Int24 is decoded shifted up by 8)
+    constexpr auto FLOAT32_SCALE = 32768.0f;
+
+    // Looked up once per call, not per sample
+    template <Samples::Format Format>
+    inline const float* decodeTable()
+    {
+        if constexpr (IS_TABLE_DECODED<Format>)
+            return Samples::decodeTable(Format);
+        else
+            return nullptr;
+    }
+
+    // table is decodeTable<Format>(). Multi-byte values are copied out rather
+    // than read in place (spans can start at any byte)
+    template <Samples::Format Format>
+    inline float decodeSample(const unsigned char* sample, const float* table)
+    {
+        if constexpr (Format == Samples::Int16)
+        {
+            std::int16_t value{};
+            std::memcpy(&value, sample, sizeof(value));
+
+            return value;
+        }
+        else if constexpr (Format == Samples::Int16BigEndian)
+        {
+            return static_cast<std::int16_t>((sample[0] << 8) | sample[1]);
+        }
+        else if constexpr (Format == Samples::Int8)
+        {
+            return static_cast<std::int8_t>(sample[0]) * 256.0f;
+        }
+        else if constexpr (Format == Samples::Int24)
+        {
+            // In the top 3 bytes, so the sign comes along for free (the same
+            // as the vector versions do it)
+            auto shifted = static_cast<std::int32_t>
+            (
+                (std::uint32_t(sample[0]) << 8)
+                | (std::uint32_t(sample[1]) << 16)
+                | (std::uint32_t(sample[2]) << 24)
+            );
+
+            return static_cast<float>(shifted) * INT24_SCALE;
+        }
+        else if constexpr (Format == Samples::Float32)
+        {
+            float value{};
+            std::memcpy(&value, sample, sizeof(value));
+
+            return value * FLOAT32_SCALE;
+        }
+        else
+        {
+            return table[sample[0]];
+        }
+    }
+
+} // namespace
@@ -0,0 +1,94 @@
+#include "Samples.h"
+#include "SimdKernels.h"
+#include "SimdSamples.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// The fallback (and the reference the others should agree with)
+namespace
+{
+    // Fixed (when not 0) replaces count with a compile-time constant, for
+    // the whole-frame versions
+    template <Samples::Format Format, std::size_t Fixed = 0>
+    float convert(const unsigned char* samples, std::size_t count, float* out)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        constexpr auto bytes = BYTES_PER_SAMPLE<Format>;
+        auto table = decodeTable<Format>();
+        auto energy = 0.0f;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            out[i] = decodeSample<Format>(samples + (i * bytes), table);
+            energy += out[i] * out[i];
+        }
+
+        return energy;
+    }
+
+    template <Samples::Format Format, std::size_t Fixed = 0>
+    float convertWindowed
+    (
+        const unsigned char* samples,
+        const float* window,
+        std::size_t count,
+        float* out
+    )
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        constexpr auto bytes = BYTES_PER_SAMPLE<Format>;
+        auto table = decodeTable<Format>();
+        auto energy = 0.0f;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            out[i] = decodeSample<Format>(samples + (i * bytes), table) * window[i];
+            energy += out[i] * out[i];
+        }
+
+        return energy;
+    }
+
+    void zero(float* out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            out[i] = 0.0f;
+    }
+
+    template <std::size_t Fixed = 0>
+    void magnitudes(const float* real, const float* imag, std::size_t count, float* out)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        for (std::size_t k = 0; k < count; ++k)
+            out[k] = std::sqrt((real[k] * real[k]) + (imag[k] * imag[k]));
+    }
+
+    template <std::size_t Fixed = 0>
+    bool allAbove(const float* real, const float* imag, std::size_t count, float thresholdSq)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        for (std::size_t k = 0; k < count; ++k)
+        {
+            // Written so a NaN fails
+            if (!((real[k] * real[k]) + (imag[k] * imag[k]) > thresholdSq)) return false;
+        }
+
+        return true;
+    }
+
+#include "SimdTables.h"
+
+} // namespace
+
+const Simd::Kernels& Simd::scalarKernels() noexcept
+{
+    static constexpr auto kernels = kernelTable();
+
+    return kernels;
+}
@@ -0,0 +1,231 @@
+#include "Samples.h"
+#include "SimdKernels.h"
+#include "SimdSamples.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#include <immintrin.h>
+
+// Built with -msse4.1 (for _mm_cvtepi16_epi32 and the other widening
+// conversions, and pshufb). 4 floats per register, but decoding 8 samples
+// per step, so an Int16 load is a full 16 bytes
+namespace
+{
+    // Decodes 8 samples to two registers of 4 floats
+    template <Samples::Format Format>
+    inline void decode(const unsigned char* samples, const float* table, __m128& lo, __m128& hi)
+    {
+        if constexpr (Format == Samples::Int16 || Format == Samples::Int16BigEndian)
+        {
+            auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples));
+
+            // (Swapping each 16-bit lane's bytes)
+            if constexpr (Format == Samples::Int16BigEndian)
+                packed = _mm_or_si128(_mm_slli_epi16(packed, 8), _mm_srli_epi16(packed, 8));
+
+            lo = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(packed));
+            hi = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(packed, 8)));
+        }
+        else if constexpr (Format == Samples::Int8)
+        {
+            // (Shifted up into the Int16 range before converting, so exact)
+            auto packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples));
+            lo = _mm_cvtepi32_ps(_mm_slli_epi32(_mm_cvtepi8_epi32(packed), 8));
+            hi = _mm_cvtepi32_ps(_mm_slli_epi32(_mm_cvtepi8_epi32(_mm_srli_si128(packed, 4)), 8));
+        }
+        else if constexpr (Format == Samples::Int24)
+        {
+            // Each sample's 3 bytes go to the top of a 32-bit lane. The
+            // second load ends right at the 24th byte, so nothing past the
+            // 8 samples is read
+            auto first = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+            auto second = _mm_setr_epi8(-1, 4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15);
+            auto scale = _mm_set1_ps(INT24_SCALE);
+
+            auto lo_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples));
+            auto hi_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + 8));
+            lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(lo_bytes, first)), scale);
+            hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(hi_bytes, second)), scale);
+        }
+        else if constexpr (Format == Samples::Float32)
+        {
+            auto scale = _mm_set1_ps(FLOAT32_SCALE);
+            lo = _mm_mul_ps(_mm_loadu_ps(reinterpret_cast<const float*>(samples)), scale);
+            hi = _mm_mul_ps(_mm_loadu_ps(reinterpret_cast<const float*>(samples) + 4), scale);
+        }
+        else
+        {
+            // No gather before AVX2, so one lookup per lane
+            lo = _mm_setr_ps(table[samples[0]], table[samples[1]], table[samples[2]], table[samples[3]]);
+            hi = _mm_setr_ps(table[samples[4]], table[samples[5]], table[samples[6]], table[samples[7]]);
+        }
+    }
+
+    inline float sum(__m128 v)
+    {
+        v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+        return _mm_cvtss_f32(v);
+    }
+
+    // Fixed (when not 0) replaces count with a compile-time constant, for
+    // the whole-frame versions
+    template <Samples::Format Format, std::size_t Fixed = 0>
+    float convert(const unsigned char* samples, std::size_t count, float* out)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        constexpr auto bytes = BYTES_PER_SAMPLE<Format>;
+        auto table = decodeTable<Format>();
+        auto energy = _mm_setzero_ps();
+        std::size_t i = 0;
+
+        for (; i + 7 < count; i += 8)
+        {
+            __m128 lo, hi;
+            decode<Format>(samples + (i * bytes), table, lo, hi);
+            _mm_storeu_ps(out + i, lo);
+            _mm_storeu_ps(out + i + 4, hi);
+            energy = _mm_add_ps(energy, _mm_add_ps(_mm_mul_ps(lo, lo), _mm_mul_ps(hi, hi)));
+        }
+
+        auto tail_energy = 0.0f;
+
+        // Whole frames are always a multiple of 8
+        if constexpr (Fixed == 0 || Fixed % 8 != 0)
+        {
+            for (; i < count; ++i)
+            {
+                out[i] = decodeSample<Format>(samples + (i * bytes), table);
+                tail_energy += out[i] * out[i];
+            }
+        }
+
+        return sum(energy) + tail_energy;
+    }
+
+    template <Samples::Format Format, std::size_t Fixed = 0>
+    float convertWindowed
+    (
+        const unsigned char* samples,
+        const float* window,
+        std::size_t count,
+        float* out
+    )
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        constexpr auto bytes = BYTES_PER_SAMPLE<Format>;
+        auto table = decodeTable<Format>();
+        auto energy = _mm_setzero_ps();
+        std::size_t i = 0;
+
+        for (; i + 7 < count; i += 8)
+        {
+            __m128 lo, hi;
+            decode<Format>(samples + (i * bytes), table, lo, hi);
+            lo = _mm_mul_ps(lo, _mm_loadu_ps(window + i));
+            hi = _mm_mul_ps(hi, _mm_loadu_ps(window + i + 4));
+            _mm_storeu_ps(out + i, lo);
+            _mm_storeu_ps(out + i + 4, hi);
+            energy = _mm_add_ps(energy, _mm_add_ps(_mm_mul_ps(lo, lo), _mm_mul_ps(hi, hi)));
+        }
+
+        auto tail_energy = 0.0f;
+
+        if constexpr (Fixed == 0 || Fixed % 8 != 0)
+        {
+            for (; i < count; ++i)
+            {
+                out[i] = decodeSample<Format>(samples + (i * bytes), table) * window[i];
+                tail_energy += out[i] * out[i];
+            }
+        }
+
+        return sum(energy) + tail_energy;
+    }
+
+    void zero(float* out, std::size_t count)
+    {
+        auto zeros = _mm_setzero_ps();
+        std::size_t i = 0;
+
+        for (; i + 3 < count; i += 4)
+            _mm_storeu_ps(out + i, zeros);
+
+        for (; i < count; ++i)
+            out[i] = 0.0f;
+    }
+
+    template <std::size_t Fixed = 0>
+    void magnitudes(const float* real, const float* imag, std::size_t count, float* out)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        std::size_t k = 0;
+
+        for (; k + 3 < count; k += 4)
+        {
+            auto re = _mm_loadu_ps(real + k);
+            auto im = _mm_loadu_ps(imag + k);
+
+            auto power = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+            _mm_storeu_ps(out + k, _mm_sqrt_ps(power));
+        }
+
+        for (; k < count; ++k)
+        {
+            auto power = (real[k] * real[k]) + (imag[k] * imag[k]);
+            out[k] = _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(power)));
+        }
+    }
+
+    template <std::size_t Fixed = 0>
+    bool allAbove(const float* real, const float* imag, std::size_t count, float thresholdSq)
+    {
+        if constexpr (Fixed != 0) count = Fixed;
+
+        auto threshold_sq = _mm_set1_ps(thresholdSq);
+        std::size_t k = 0;
+
+        for (; k + 3 < count; k += 4)
+        {
+            auto re = _mm_loadu_ps(real + k);
+            auto im = _mm_loadu_ps(imag + k);
+
+            auto power = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+
+            if (_mm_movemask_ps(_mm_cmpgt_ps(power, threshold_sq)) != 0xF) return false;
+        }
+
+        for (; k < count; ++k)
+        {
+            if (!((real[k] * real[k]) + (imag[k] * imag[k]) > thresholdSq)) return false;
+        }
+
+        return true;
+    }
+
+#include "SimdTables.h"
+
+} // namespace
+
+const Simd::Kernels& Simd::sse41Kernels() noexcept
+{
+    static constexpr auto kernels = kernelTable();
+
+    return kernels;
+}
+
+#else
+
+// Never selected off x86
+const Simd::Kernels& Simd::sse41Kernels() noexcept
+{
+    return scalarKernels();
+}
+
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+
+// The kernel table, wired up the same way for every instruction set. This is
+// included at the end of each kernel file's unnamed namespace (so no includes
+// of its own), after that file's convert, convertWindowed, zero, magnitudes
+// and allAbove, and so binds that file's versions of them (see
+// SimdSamples.h for why nothing here can be shared across files)
+
+// One format's converts
+template <Samples::Format Format>
+constexpr Simd::ConvertKernels convertKernels()
+{
+    return { convert<Format>, convertWindowed<Format> };
+}
+
+template <Samples::Format Format, std::size_t FftSize>
+constexpr Simd::FrameConvertKernels frameConvertKernels()
+{
+    return
+    {
+        [](const unsigned char* samples, float* out)
+        {
+            return convert<Format, FftSize>(samples, FftSize, out);
+        },
+        [](const unsigned char* samples, const float* window, float* out)
+        {
+            return convertWindowed<Format, FftSize>(samples, window, FftSize, out);
+        }
+    };
+}
+
+// The fixed-size instantiations for one FFT size
+template <std::size_t FftSize>
+constexpr Simd::FrameKernels fixedFrameKernels()
+{
+    return
+    {
+        FftSize,
+        {
+            frameConvertKernels<Samples::Int16, FftSize>(),
+            frameConvertKernels<Samples::Int16BigEndian, FftSize>(),
+            frameConvertKernels<Samples::Int8, FftSize>(),
+            frameConvertKernels<Samples::Int24, FftSize>(),
+            frameConvertKernels<Samples::Float32, FftSize>(),
+            frameConvertKernels<Samples::MuLaw, FftSize>(),
+            frameConvertKernels<Samples::ALaw, FftSize>()
+        },
+        [](const float* real, const float* imag, float* out)
+        {
+            magnitudes<(FftSize / 2) + 1>(real, imag, (FftSize / 2) + 1, out);
+        },
+        [](const float* real, const float* imag, float thresholdSq)
+        {
+            return allAbove<(FftSize / 2) + 1>(real, imag, (FftSize / 2) + 1, thresholdSq);
+        }
+    };
+}
+
+// (Each file's scalarKernels, sse41Kernels, ... keeps one of these. One
+// fixedFrameKernels per FIXED_FFT_SIZES)
+constexpr Simd::Kernels kernelTable()
+{
+    return
+    {
+        {
+            convertKernels<Samples::Int16>(),
+            convertKernels<Samples::Int16BigEndian>(),
+            convertKernels<Samples::Int8>(),
+            convertKernels<Samples::Int24>(),
+            convertKernels<Samples::Float32>(),
+            convertKernels<Samples::MuLaw>(),
+            convertKernels<Samples::ALaw>()
+        },
+        zero,
+        magnitudes<>,
+        allAbove<>,
+        {
+            fixedFrameKernels<Simd::FIXED_FFT_SIZES[0]>(),
+            fixedFrameKernels<Simd::FIXED_FFT_SIZES[1]>(),
+            fixedFrameKernels<Simd::FIXED_FFT_SIZES[2]>()
+        }
+    };
+}
@@ -0,0 +1,263 @@
+#include "Spectrogram.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <ios>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define HAVE_MMAP
+
+#endif
+
+constexpr auto FLOAT32 = "f32";
+constexpr auto FLOAT16 = "f16";
+constexpr auto LOG_UINT8 = "u8";
+
+// Rows start on a multiple of this (NumPy pads its own headers to 64 too)
+constexpr std::size_t HEADER_ALIGNMENT = 64;
+
+// Round to nearest even, like a hardware conversion would. Magnitudes are
+// never negative (or NaN), and anything too big for a half is capped at its
+// largest finite value rather than becoming infinity
+static std::uint16_t toHalf_(float value) noexcept
+{
+    std::uint32_t bits{};
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    auto exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+    auto mantissa = bits & 0x7FFFFF;
+
+    if (exponent >= 31) return 0x7BFF;
+
+    // Subnormal (or zero) as a half
+    if (exponent <= 0)
+    {
+        if (exponent < -10) return 0;
+
+        mantissa |= 0x800000;
+        auto shift = static_cast<std::uint32_t>(14 - exponent);
+        auto half = mantissa >> shift;
+        auto rest = mantissa & ((1u << shift) - 1);
+        auto halfway = 1u << (shift - 1);
+
+        if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+        return static_cast<std::uint16_t>(half);
+    }
+
+    auto half = (static_cast<std::uint32_t>(exponent) << 10) | (mantissa >> 13);
+    auto rest = mantissa & 0x1FFF;
+
+    // (A carry out of the mantissa bumps the exponent, which is just right)
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half;
+
+    return static_cast<std::uint16_t>(std::min(half, std::uint32_t(0x7BFF)));
+}
+
+std::string Spectrogram::toString(Format format) noexcept
+{
+    switch (format)
+    {
+    case Float16:   return FLOAT16;
+    case LogUint8:  return LOG_UINT8;
+
+    default:
+    case Float32:   return FLOAT32;
+    }
+}
+
+Spectrogram::Format Spectrogram::fromString(const std::string& string) noexcept
+{
+    auto normalized = string;
+
+    std::transform
+    (
+        normalized.begin(),
+        normalized.end(),
+        normalized.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); }
+    );
+
+    if (normalized == FLOAT16)          return Float16;
+    else if (normalized == LOG_UINT8)   return LogUint8;
+    else                                return Float32;
+}
+
+Spectrogram::Spectrogram
+(
+    const std::filesystem::path& path,
+    std::size_t framesCount,
+    std::size_t fftSize,
+    std::size_t firstBin,
+    std::size_t endBin,
+    Format format
+)
+    : framesCount_(framesCount)
+    , firstBin_(firstBin)
+    , binsCount_(endBin - firstBin)
+    , format_(format)
+{
+    auto element_bytes = (format_ == Float32) ? 4 : (format_ == Float16) ? 2 : 1;
+    rowBytes_ = binsCount_ * element_bytes;
+    logScale_ = 255.0f / std::log10(32768.0f * static_cast<float>(fftSize));
+
+    auto header = header_();
+    headerBytes_ = header.size();
+    auto file_bytes = headerBytes_ + (framesCount_ * rowBytes_);
+
+#if defined(HAVE_MMAP)
+
+    auto fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0)
+        throw std::runtime_error("Unable to create \"" + path.string() + "\": " + std::strerror(errno));
+
+    // Sized (and, where the file system can, allocated) up front, so filling
+    // the mapping never hits a full disk as SIGBUS halfway through
+    auto sized = ::ftruncate(fd, static_cast<off_t>(file_bytes)) == 0;
+
+#if defined(__linux__)
+    // (Returns the error instead of setting errno)
+    if (auto result = sized ? ::posix_fallocate(fd, 0, static_cast<off_t>(file_bytes)) : 0; result != 0)
+    {
+        errno = result;
+        sized = false;
+    }
+#endif
+
+    auto mapping = sized
+        ? ::mmap(nullptr, file_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+        : MAP_FAILED;
+
+    auto error = errno;
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Unable to size or map \"" + path.string() + "\": " + std::strerror(error));
+
+    // Rows are written front to back (mostly), and never read back
+    ::madvise(mapping, file_bytes, MADV_SEQUENTIAL);
+
+    mapping_ = mapping;
+    mappingSize_ = file_bytes;
+    std::memcpy(mapping_, header.data(), headerBytes_);
+    data_ = static_cast<unsigned char*>(mapping_) + headerBytes_;
+
+#else // !defined(HAVE_MMAP)
+
+    stream_.open(path, std::ios::binary | std::ios::trunc);
+    stream_.write(header.data(), static_cast<std::streamsize>(headerBytes_));
+
+    // Zeros for rows that are never written (a file that shrank)
+    std::vector<char> zeros(rowBytes_, 0);
+
+    for (std::size_t i = 0; i < framesCount_ && stream_; ++i)
+        stream_.write(zeros.data(), static_cast<std::streamsize>(rowBytes_));
+
+    if (!stream_)
+        throw std::runtime_error("Unable to create \"" + path.string() + "\"");
+
+#endif // defined(HAVE_MMAP)
+}
+
+Spectrogram::~Spectrogram()
+{
+#if defined(HAVE_MMAP)
+    // (Dirty pages are written back by the kernel whenever it likes; munmap
+    // doesn't wait for them)
+    if (mapping_) ::munmap(mapping_, mappingSize_);
+#endif
+}
+
+void Spectrogram::write(std::size_t frame, const float* magnitudes)
+{
+    if (frame >= framesCount_) return;
+
+    if (data_)
+    {
+        convertRow_(magnitudes + firstBin_, data_ + (frame * rowBytes_));
+        return;
+    }
+
+    // Slow path (no mmap): convert into a small row buffer, then seek and
+    // write it
+    std::lock_guard<std::mutex> lock(streamMutex_);
+    thread_local std::vector<unsigned char> row{};
+    row.resize(rowBytes_);
+    convertRow_(magnitudes + firstBin_, row.data());
+
+    stream_.seekp(static_cast<std::streamoff>(headerBytes_ + (frame * rowBytes_)));
+    stream_.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(rowBytes_));
+}
+
+// Version 1.0: magic, version, little-endian header length, then a Python
+// dict literal padded with spaces (and ending in a newline) to the alignment
+std::string Spectrogram::header_() const
+{
+    auto descr = (format_ == Float32) ? "<f4" : (format_ == Float16) ? "<f2" : "|u1";
+
+    std::string dict = "{'descr': '" + std::string(descr) + "', 'fortran_order': False, 'shape': ("
+        + std::to_string(framesCount_) + ", " + std::to_string(binsCount_) + "), }";
+
+    // Magic (6) + version (2) + length (2)
+    constexpr std::size_t PREAMBLE_BYTES = 10;
+    auto unpadded = PREAMBLE_BYTES + dict.size() + 1;
+    auto padded = ((unpadded + HEADER_ALIGNMENT - 1) / HEADER_ALIGNMENT) * HEADER_ALIGNMENT;
+    dict.append(padded - unpadded, ' ');
+    dict += '\n';
+
+    auto dict_bytes = dict.size();
+
+    std::string header = "\x93NUMPY";
+    header += '\x01';
+    header += '\x00';
+    header += static_cast<char>(dict_bytes & 0xFF);
+    header += static_cast<char>((dict_bytes >> 8) & 0xFF);
+
+    return header + dict;
+}
+
+// Straight into the row (in the mapping, usually). Values are copied in the
+// host's byte order, which the header claims is little-endian (x86 and ARM)
+void Spectrogram::convertRow_(const float* magnitudes, unsigned char* row) const noexcept
+{
+    switch (format_)
+    {
+    case Float16:
+        for (std::size_t i = 0; i < binsCount_; ++i)
+        {
+            auto half = toHalf_(magnitudes[i]);
+            std::memcpy(row + (i * 2), &half, 2);
+        }
+        break;
+
+    case LogUint8:
+        for (std::size_t i = 0; i < binsCount_; ++i)
+        {
+            auto level = std::log10(std::max(magnitudes[i], 1.0f)) * logScale_;
+            row[i] = static_cast<unsigned char>(std::min(255.0f, level + 0.5f));
+        }
+        break;
+
+    default:
+    case Float32:
+        std::memcpy(row, magnitudes, rowBytes_);
+        break;
+    }
+}
+
+#undef HAVE_MMAP
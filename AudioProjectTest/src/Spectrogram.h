@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+// One file's per-chunk magnitudes, written as a NumPy .npy array of shape
+// (frames, bins) as the chunks are analyzed, for checking the detector's
+// decisions offline (np.load(path, mmap_mode="r")).
+//
+// The whole file is sized up front and memory-mapped, so each row is
+// converted straight into the page cache: no buffer in between, and nothing
+// to seek. Rows can be written from several threads at once, as long as each
+// row only ever comes from one. Without mmap (not Unix), rows go through a
+// stream instead, one at a time
+class Spectrogram
+{
+public:
+    enum Format
+    {
+        Float32 = 0, // The magnitudes as computed
+        Float16, // Same, rounded to half precision (and capped at 65504)
+        LogUint8 // 255 * log10(magnitude) / log10(32768 * fftSize), from 0
+    };
+
+    static std::string toString(Format format) noexcept;
+    static Format fromString(const std::string& string) noexcept;
+
+    // Only bins [firstBin, endBin) of each row are kept. Throws if the file
+    // can't be created
+    Spectrogram
+    (
+        const std::filesystem::path& path,
+        std::size_t framesCount,
+        std::size_t fftSize,
+        std::size_t firstBin,
+        std::size_t endBin,
+        Format format
+    );
+
+    virtual ~Spectrogram();
+
+    Spectrogram(const Spectrogram&) = delete;
+    Spectrogram& operator=(const Spectrogram&) = delete;
+
+    // Row frame, from a whole chunk's magnitudes. Frames past the end (a file
+    // that grew while it was read) are dropped
+    void write(std::size_t frame, const float* magnitudes);
+
+private:
+    std::size_t framesCount_;
+    std::size_t firstBin_;
+    std::size_t binsCount_;
+    Format format_;
+    std::size_t rowBytes_;
+    std::size_t headerBytes_ = 0;
+
+    // 255 / log10(the largest possible magnitude), for LogUint8
+    float logScale_ = 0.0f;
+
+    void* mapping_ = nullptr;
+    std::size_t mappingSize_ = 0;
+    unsigned char* data_ = nullptr; // First row, in the mapping
+
+    // Without a mapping
+    std::ofstream stream_{};
+    std::mutex streamMutex_{};
+
+    std::string header_() const;
+    void convertRow_(const float* magnitudes, unsigned char* row) const noexcept;
+
+}; // class Spectrogram
@@ -0,0 +1,185 @@
+#include "Json.h"
+#include "Stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ios>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+// Doubles as plain JSON numbers (never NaN or infinite here, since every
+// ratio checks its denominator)
+static std::string number_(double value)
+{
+    std::ostringstream oss{};
+    oss << std::setprecision(6) << value;
+    return oss.str();
+}
+
+static void writeSeconds_(std::ostream& os, const Stats::Counters& counters)
+{
+    os << "{";
+
+    for (std::size_t i = 0; i < Stats::STAGES_COUNT; ++i)
+    {
+        if (i > 0) os << ", ";
+        os << Json::quoted(Stats::toString(static_cast<Stats::Stage>(i))) << ": " << number_(counters.seconds[i]);
+    }
+
+    os << "}";
+}
+
+// Each perf-timed stage's counts, in total, per frame and per sample (the
+// input's samples, whatever their format). Events the CPU doesn't have are left out
+static void writePerf_(std::ostream& os, const Stats::Counters& totals, std::size_t frames)
+{
+    os << "  \"perf\": {\n"
+        << "    \"available\": " << (PerfCounters::available() ? "true" : "false");
+
+    if (!PerfCounters::available())
+    {
+        os << ",\n    \"reason\": " << Json::quoted(PerfCounters::unavailableReason()) << "\n  },\n";
+        return;
+    }
+
+    auto samples = static_cast<double>(totals.samples);
+    const Stats::Stage stages[] = { Stats::Convert, Stats::Fft, Stats::Detect };
+
+    for (auto stage : stages)
+    {
+        os << ",\n    " << Json::quoted(Stats::toString(stage)) << ": {";
+
+        auto first = true;
+
+        for (std::size_t i = 0; i < PerfCounters::EVENTS_COUNT; ++i)
+        {
+            auto event = static_cast<PerfCounters::Event>(i);
+            if (!PerfCounters::available(event)) continue;
+
+            auto count = totals.perf[stage].counts[i];
+
+            os << (first ? "" : ", ") << Json::quoted(PerfCounters::toString(event))
+                << ": {\"total\": " << number_(count)
+                << ", \"perFrame\": " << number_(frames ? count / frames : 0.0)
+                << ", \"perSample\": " << number_(samples > 0.0 ? count / samples : 0.0) << "}";
+
+            first = false;
+        }
+
+        os << "}";
+    }
+
+    os << "\n  },\n";
+}
+
+namespace Stats
+{
+    std::string toString(Stage stage) noexcept
+    {
+        switch (stage)
+        {
+        case Read:      return "read";
+        case Convert:   return "convert";
+        case Fft:       return "fft";
+        case Detect:    return "detect";
+        case Output:    return "output";
+
+        default:        return "unknown";
+        }
+    }
+
+    Counters& Counters::operator+=(const Counters& other) noexcept
+    {
+        bytes += other.bytes;
+        samples += other.samples;
+
+        for (std::size_t i = 0; i < STAGES_COUNT; ++i)
+        {
+            seconds[i] += other.seconds[i];
+            perf[i] += other.perf[i];
+        }
+
+        return *this;
+    }
+
+    void writeJson(std::ostream& os, const Report& report)
+    {
+        Counters totals{};
+        std::size_t frames = 0;
+        std::size_t skipped_frames = 0;
+        std::size_t failed_files = 0;
+
+        for (auto& file : report.files)
+        {
+            totals += file.counters;
+            frames += file.frames;
+            skipped_frames += file.skippedFrames;
+            if (!file.error.empty()) ++failed_files;
+        }
+
+        auto stages_seconds = 0.0;
+        for (auto seconds : totals.seconds) stages_seconds += seconds;
+
+        auto per_second = [&report](double value)
+            {
+                return report.wallSeconds > 0.0 ? value / report.wallSeconds : 0.0;
+            };
+
+        os << "{\n"
+            << "  \"simd\": " << Json::quoted(report.simd) << ",\n"
+            << "  \"threads\": " << report.threads << ",\n"
+            << "  \"planSeconds\": " << number_(report.planSeconds) << ",\n"
+            << "  \"wisdomLoadSeconds\": " << number_(report.wisdomLoadSeconds) << ",\n"
+            << "  \"wallSeconds\": " << number_(report.wallSeconds) << ",\n"
+            << "  \"files\": " << report.files.size() << ",\n"
+            << "  \"failedFiles\": " << failed_files << ",\n"
+            << "  \"frames\": " << frames << ",\n"
+            << "  \"skippedFrames\": " << skipped_frames << ",\n"
+            << "  \"gateSkipRate\": " << number_(frames ? static_cast<double>(skipped_frames) / frames : 0.0) << ",\n"
+            << "  \"bytes\": " << totals.bytes << ",\n"
+            << "  \"framesPerSecond\": " << number_(per_second(static_cast<double>(frames))) << ",\n"
+            << "  \"megabytesPerSecond\": " << number_(per_second(totals.bytes / 1e6)) << ",\n"
+            << "  \"stages\": {\n";
+
+        for (std::size_t i = 0; i < STAGES_COUNT; ++i)
+        {
+            auto seconds = totals.seconds[i];
+            auto percent = stages_seconds > 0.0 ? (100.0 * seconds) / stages_seconds : 0.0;
+
+            os << "    " << Json::quoted(toString(static_cast<Stage>(i)))
+                << ": {\"seconds\": " << number_(seconds)
+                << ", \"percent\": " << number_(percent) << "}"
+                << ((i + 1 < STAGES_COUNT) ? ",\n" : "\n");
+        }
+
+        os << "  },\n";
+
+        if (report.perf) writePerf_(os, totals, frames);
+
+        os << "  \"perFile\": [";
+
+        for (std::size_t i = 0; i < report.files.size(); ++i)
+        {
+            auto& file = report.files[i];
+
+            os << (i > 0 ? ",\n" : "\n")
+                << "    {\"file\": " << Json::quoted(file.file.string());
+
+            if (!file.error.empty())
+                os << ", \"error\": " << Json::quoted(file.error);
+
+            os << ", \"frames\": " << file.frames
+                << ", \"skippedFrames\": " << file.skippedFrames
+                << ", \"bytes\": " << file.counters.bytes
+                << ", \"seconds\": ";
+
+            writeSeconds_(os, file.counters);
+            os << "}";
+        }
+
+        os << (report.files.empty() ? "]\n" : "\n  ]\n") << "}" << std::endl;
+    }
+
+} // namespace Stats
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "PerfCounters.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Run-time pipeline statistics (--stats): how long each stage takes, per file
+// and per run. Off unless asked for, in which case every timing point is just
+// a null check. On, it's two clock reads per timed step (per chunk for
+// converting, per read for streams, per batch for the FFT and detection),
+// cheap enough to leave on in production. Hardware counters per stage (see
+// PerfCounters) are a further opt-in, since they cost a syscall per read
+namespace Stats
+{
+    enum Stage
+    {
+        Read = 0, // Stream reads, or setting up the memory map
+        Convert, // int16 to float and windowing (and, when mapped, page faults)
+        Fft,
+        Detect,
+        Output, // Printing results
+        STAGES_COUNT
+    };
+
+    std::string toString(Stage stage) noexcept;
+
+    using Clock = std::chrono::steady_clock;
+
+    // One file's (or run's) totals. Times are summed over whichever threads
+    // did the work, so with several threads they can add up to more than the
+    // wall time
+    struct Counters
+    {
+        std::uintmax_t bytes = 0;
+        std::uintmax_t samples = 0; // Decoded (bytes / the format's sample size)
+        double seconds[STAGES_COUNT]{};
+
+        // Only for the stages timed with perf on (convert, FFT and detect)
+        PerfCounters::Values perf[STAGES_COUNT]{};
+
+        Counters& operator+=(const Counters& other) noexcept;
+    };
+
+    inline double secondsSince(Clock::time_point start) noexcept
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Adds the time until it goes out of scope to counters' stage (and, with
+    // perf, the hardware counts), unless counters is null
+    class Timer
+    {
+    public:
+        Timer(Counters* counters, Stage stage, bool perf = false) noexcept
+            : counters_(counters)
+            , stage_(stage)
+            , perf_(counters && perf)
+        {
+            if (perf_) perfStart_ = PerfCounters::read();
+            if (counters_) start_ = Clock::now();
+        }
+
+        ~Timer()
+        {
+            if (!counters_) return;
+
+            counters_->seconds[stage_] += secondsSince(start_);
+
+            if (perf_)
+            {
+                auto counts = PerfCounters::read();
+                counts -= perfStart_;
+                counters_->perf[stage_] += counts;
+            }
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Counters* counters_;
+        Stage stage_;
+        bool perf_;
+        Clock::time_point start_{};
+        PerfCounters::Values perfStart_{};
+    };
+
+    struct FileReport
+    {
+        std::filesystem::path file{};
+        std::string error{};
+        std::size_t frames = 0;
+        std::size_t skippedFrames = 0;
+        Counters counters{};
+    };
+
+    struct Report
+    {
+        std::string simd{};
+        std::size_t threads = 0;
+
+        // Making the analyzers' plans, including loading (and saving) wisdom,
+        // and how much of that was loading it
+        double planSeconds = 0.0;
+        double wisdomLoadSeconds = 0.0;
+
+        // Just the analysis, from the first file to the last result printed
+        double wallSeconds = 0.0;
+
+        // Whether hardware counters were asked for
+        bool perf = false;
+
+        std::vector<FileReport> files{};
+    };
+
+    // The whole report, as one JSON object: run totals (frames and bytes per
+    // second, each stage's share of the time, the energy gate's skip rate,
+    // and with perf, each stage's counts per frame and per sample), then
+    // every file's
+    void writeJson(std::ostream& os, const Report& report);
+
+} // namespace Stats
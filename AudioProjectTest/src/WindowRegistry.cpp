@@ -0,0 +1,73 @@
+#include "WindowRegistry.h"
+#include "Windowing.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <vector>
+
+static std::vector<float> generate_(Windowing::Window windowType, std::size_t size, float sigma)
+{
+    switch (windowType)
+    {
+    case Windowing::Triangular: return Windowing::triangular(size);
+    case Windowing::Hann:       return Windowing::hann(size);
+    case Windowing::Hamming:    return Windowing::hamming(size);
+    case Windowing::Blackman:   return Windowing::blackman(size);
+    case Windowing::FlatTop:    return Windowing::flatTop(size);
+    case Windowing::Gaussian:   return Windowing::gaussian(size, sigma);
+
+    default:
+    case Windowing::None:       return {};
+    }
+}
+
+WindowTable::WindowTable(Windowing::Window windowType, std::size_t size, float sigma)
+    : type_(windowType)
+    , size_(size)
+{
+    constexpr auto per_line = ALIGNMENT / sizeof(float);
+    paddedSize_ = ((size_ + per_line - 1) / per_line) * per_line;
+
+    // Generating first means a bad size throws before anything's allocated
+    auto window = generate_(windowType, size, sigma);
+
+    data_ = static_cast<float*>(::operator new[](paddedSize_ * sizeof(float), std::align_val_t(ALIGNMENT)));
+    std::copy(window.begin(), window.end(), data_);
+    std::fill(data_ + window.size(), data_ + paddedSize_, 0.0f);
+}
+
+WindowTable::~WindowTable()
+{
+    ::operator delete[](data_, std::align_val_t(ALIGNMENT));
+}
+
+namespace WindowRegistry
+{
+    std::shared_ptr<const WindowTable> get(Windowing::Window windowType, std::size_t size, float sigma)
+    {
+        if (windowType == Windowing::None) return nullptr;
+
+        // Sigma isn't part of any other window, so don't let it split them
+        auto key_sigma = (windowType == Windowing::Gaussian) ? sigma : 0.0f;
+
+        using Key = std::tuple<Windowing::Window, std::size_t, float>;
+        static std::mutex mutex{};
+        static std::map<Key, std::shared_ptr<const WindowTable>> tables{};
+
+        // Building under the lock is fine; it only happens once per window,
+        // and anyone else asking for it would just have to wait anyway
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& table = tables[Key{ windowType, size, key_sigma }];
+
+        if (!table)
+            table = std::make_shared<const WindowTable>(windowType, size, sigma);
+
+        return table;
+    }
+
+} // namespace WindowRegistry
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Windowing.h"
+
+#include <cstddef>
+#include <memory>
+
+// One window's coefficients, immutable once built. The storage is 64-byte
+// aligned and zero-padded up to a whole number of 64-byte lines, so vector
+// loads of the window never need a tail (or cross into someone else's line)
+class WindowTable
+{
+public:
+    static constexpr std::size_t ALIGNMENT = 64;
+
+    WindowTable(Windowing::Window windowType, std::size_t size, float sigma);
+    virtual ~WindowTable();
+
+    WindowTable(const WindowTable&) = delete;
+    WindowTable& operator=(const WindowTable&) = delete;
+
+    Windowing::Window type() const noexcept { return type_; }
+    const float* data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+
+    // size() rounded up to the alignment; data()[size()..paddedSize()) is 0
+    std::size_t paddedSize() const noexcept { return paddedSize_; }
+
+private:
+    Windowing::Window type_;
+    std::size_t size_;
+    std::size_t paddedSize_;
+    float* data_ = nullptr;
+
+}; // class WindowTable
+
+// Process-wide cache of window tables, so analyzers (one per thread, or per
+// configuration) with the same window share one copy, built once
+namespace WindowRegistry
+{
+    // The table for this window, built on first use. Null for Windowing::None.
+    // sigma only matters for Gaussian windows. Thread-safe
+    std::shared_ptr<const WindowTable> get
+    (
+        Windowing::Window windowType,
+        std::size_t size,
+        float sigma = Windowing::DEFAULT_SIGMA
+    );
+
+} // namespace WindowRegistry
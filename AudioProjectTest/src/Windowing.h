@@ -17,6 +17,8 @@ namespace Windowing
         Gaussian
     };
 
+    constexpr auto DEFAULT_SIGMA = 0.4f;
+
     std::string toString(Window windowType) noexcept;
     Window fromString(const std::string& string) noexcept;
     std::vector<float> triangular(std::size_t size);
@@ -24,6 +26,6 @@ namespace Windowing
     std::vector<float> hamming(std::size_t size);
     std::vector<float> blackman(std::size_t size);
     std::vector<float> flatTop(std::size_t size);
-    std::vector<float> gaussian(std::size_t size, float sigma = 0.4f);
+    std::vector<float> gaussian(std::size_t size, float sigma = DEFAULT_SIGMA);
 
 } // namespace Windowing
@@ -0,0 +1,173 @@
+#include "Wisdom.h"
+
+#include "fftw3.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#define HAVE_FLOCK
+
+#endif
+
+constexpr auto AUTO = "auto";
+constexpr auto ESTIMATE = "estimate";
+constexpr auto MEASURE = "measure";
+constexpr auto PATIENT = "patient";
+constexpr auto EXHAUSTIVE = "exhaustive";
+
+// Exclusive lock on a file, released (and closed) on destruction
+class FileLock_
+{
+public:
+    explicit FileLock_(const std::filesystem::path& path)
+    {
+#if defined(HAVE_FLOCK)
+
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+
+        if (fd_ < 0 || ::flock(fd_, LOCK_EX) != 0)
+        {
+            if (fd_ >= 0) ::close(fd_);
+
+            std::ostringstream oss{};
+            oss << "Unable to lock \"" << path.string() << "\"";
+            throw std::runtime_error(oss.str());
+        }
+
+#else
+        // No locking on this platform (yet); the rename still keeps readers
+        // from seeing partial files
+        (void)path;
+#endif
+    }
+
+    ~FileLock_()
+    {
+#if defined(HAVE_FLOCK)
+        ::flock(fd_, LOCK_UN);
+        ::close(fd_);
+#endif
+    }
+
+    FileLock_(const FileLock_&) = delete;
+    FileLock_& operator=(const FileLock_&) = delete;
+
+private:
+    int fd_ = -1;
+};
+
+static std::filesystem::path withSuffix_(const std::filesystem::path& path, const std::string& suffix)
+{
+    auto result = path;
+    result += suffix;
+    return result;
+}
+
+namespace Wisdom
+{
+    Planner resolve(Planner planner, bool haveWisdomFile) noexcept
+    {
+        if (planner != Auto) return planner;
+        return haveWisdomFile ? Measure : Estimate;
+    }
+
+    unsigned flags(Planner planner, bool haveWisdomFile) noexcept
+    {
+        switch (resolve(planner, haveWisdomFile))
+        {
+        case Measure:       return FFTW_MEASURE;
+        case Patient:       return FFTW_PATIENT;
+        case Exhaustive:    return FFTW_EXHAUSTIVE;
+
+        default:
+        case Estimate:      return FFTW_ESTIMATE;
+        }
+    }
+
+    bool load(const std::filesystem::path& path)
+    {
+        return fftwf_import_wisdom_from_filename(path.string().c_str()) != 0;
+    }
+
+    std::string snapshot()
+    {
+        std::unique_ptr<char, void(*)(void*)> wisdom(fftwf_export_wisdom_to_string(), std::free);
+        return wisdom ? std::string(wisdom.get()) : std::string{};
+    }
+
+    void save(const std::filesystem::path& path)
+    {
+        if (path.has_parent_path())
+            std::filesystem::create_directories(path.parent_path());
+
+        FileLock_ lock(withSuffix_(path, ".lock"));
+
+        // Someone else may have saved since we loaded. (Fine if there's no
+        // file yet)
+        load(path);
+
+        // (Only ever written while holding the lock, so one name will do)
+        auto temp_path = withSuffix_(path, ".tmp");
+
+        if (!fftwf_export_wisdom_to_filename(temp_path.string().c_str()))
+        {
+            std::error_code ec{};
+            std::filesystem::remove(temp_path, ec);
+
+            std::ostringstream oss{};
+            oss << "Failed to save wisdom to disk (" << path.string() << ")";
+            throw std::runtime_error(oss.str());
+        }
+
+        std::filesystem::rename(temp_path, path);
+    }
+
+    std::string toString(Planner planner) noexcept
+    {
+        switch (planner)
+        {
+        case Estimate:      return ESTIMATE;
+        case Measure:       return MEASURE;
+        case Patient:       return PATIENT;
+        case Exhaustive:    return EXHAUSTIVE;
+
+        default:
+        case Auto:          return AUTO;
+        }
+    }
+
+    Planner fromString(const std::string& string) noexcept
+    {
+        auto normalized = string;
+
+        std::transform
+        (
+            normalized.begin(),
+            normalized.end(),
+            normalized.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); }
+        );
+
+        if (normalized == ESTIMATE)         return Estimate;
+        else if (normalized == MEASURE)     return Measure;
+        else if (normalized == PATIENT)     return Patient;
+        else if (normalized == EXHAUSTIVE)  return Exhaustive;
+        else                                return Auto;
+    }
+
+} // namespace Wisdom
+
+#undef HAVE_FLOCK
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+// FFTW wisdom files, and how hard the planner tries. Wisdom is FFTW's global
+// store of plans, so none of this is thread-safe (neither is planning)
+namespace Wisdom
+{
+    enum Planner
+    {
+        Auto = 0, // Measure with a wisdom file, estimate without
+        Estimate,
+        Measure,
+        Patient,
+        Exhaustive
+    };
+
+    // Auto as whichever planner it stands for
+    Planner resolve(Planner planner, bool haveWisdomFile) noexcept;
+
+    unsigned flags(Planner planner, bool haveWisdomFile) noexcept;
+
+    // Adds the file's plans to FFTW's wisdom. False if there's no (valid)
+    // file
+    bool load(const std::filesystem::path& path);
+
+    // FFTW's current wisdom, for checking whether planning added anything
+    std::string snapshot();
+
+    // Merges FFTW's current wisdom into the file. Holds an exclusive lock on
+    // a lock file next to it while re-importing whatever's there now (so
+    // processes saving at the same time don't drop each other's plans) and
+    // writing a temp file that's renamed over the original, so readers never
+    // see a partial file. Throws on failure
+    void save(const std::filesystem::path& path);
+
+    std::string toString(Planner planner) noexcept;
+    Planner fromString(const std::string& string) noexcept;
+
+} // namespace Wisdom
@@ -0,0 +1,139 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+WorkStealingPool::WorkStealingPool(std::size_t threadCount)
+{
+    threadCount = std::max(std::size_t(1), threadCount);
+
+    for (std::size_t i = 0; i < threadCount; ++i)
+        queues_.emplace_back(std::make_unique<Queue_>());
+
+    for (std::size_t i = 0; i < threadCount; ++i)
+        threads_.emplace_back(&WorkStealingPool::run_, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    workAvailable_.notify_all();
+
+    for (auto& thread : threads_)
+        thread.join();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+    {
+        // Holding mutex_ across the push keeps a worker that grabs the task
+        // straight away from decrementing queued_ before we've incremented it
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& queue = *queues_[nextQueue_];
+        nextQueue_ = (nextQueue_ + 1) % queues_.size();
+
+        {
+            std::lock_guard<std::mutex> queue_lock(queue.mutex);
+            queue.tasks.emplace_back(std::move(task));
+        }
+
+        ++queued_;
+        ++unfinished_;
+    }
+
+    workAvailable_.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    allDone_.wait(lock, [this] { return unfinished_ == 0; });
+
+    if (error_)
+    {
+        auto error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkStealingPool::run_(std::size_t workerIndex)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            workAvailable_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+
+            if (stopping_ && queued_ == 0) return;
+        }
+
+        Task task{};
+        if (!pop_(workerIndex, task)) continue;
+
+        bool skip = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --queued_;
+            skip = static_cast<bool>(error_);
+        }
+
+        if (!skip)
+        {
+            try
+            {
+                task(workerIndex);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) error_ = std::current_exception();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--unfinished_ == 0) allDone_.notify_all();
+    }
+}
+
+bool WorkStealingPool::pop_(std::size_t workerIndex, Task& task)
+{
+    // Own deque first (front), so tasks are run roughly in submission order
+    {
+        auto& own = *queues_[workerIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    // Then steal from the back of everyone else's
+    for (std::size_t offset = 1; offset < queues_.size(); ++offset)
+    {
+        auto& victim = *queues_[(workerIndex + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Each worker owns a deque. Submitted tasks are dealt round-robin onto the
+// deques; a worker pops from the front of its own deque and, once that runs
+// dry, steals from the back of the others. A single long task therefore only
+// ever ties up the one worker running it.
+class WorkStealingPool
+{
+public:
+    // The argument is the index of the worker running the task, so callers
+    // can keep per-worker state (buffers, etc.) without locking
+    using Task = std::function<void(std::size_t workerIndex)>;
+
+    explicit WorkStealingPool(std::size_t threadCount);
+    virtual ~WorkStealingPool();
+
+    std::size_t size() const noexcept { return threads_.size(); }
+
+    void submit(Task task);
+
+    // Blocks until every submitted task has finished. If a task threw, the
+    // first exception is rethrown here (and tasks still queued are dropped)
+    void wait();
+
+private:
+    struct Queue_
+    {
+        std::mutex mutex{};
+        std::deque<Task> tasks{};
+    };
+
+    std::vector<std::unique_ptr<Queue_>> queues_{};
+    std::vector<std::thread> threads_{};
+
+    std::mutex mutex_{};
+    std::condition_variable workAvailable_{};
+    std::condition_variable allDone_{};
+    std::size_t queued_ = 0;
+    std::size_t unfinished_ = 0;
+    std::size_t nextQueue_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_{};
+
+    void run_(std::size_t workerIndex);
+    bool pop_(std::size_t workerIndex, Task& task);
+
+}; // class WorkStealingPool